@@ -0,0 +1,308 @@
+/*
+ * Feed replay benchmark
+ * =====================
+ *
+ * Generates a seeded synthetic stream of ORDER, CANCEL and CANCEL_REPLACE
+ * instructions, then replays it through the list processing path used in
+ * main.c: every instruction is consed onto the book, orders go through
+ * times2, and cancels look up their order with filter_by_oid and fold over
+ * the matches. With --match the stream goes through the matching engine in
+ * match.c instead. Each instruction is timed on its own and recorded in a
+ * log-linear (HDR-style) histogram.
+ *
+ * Build and run:
+ *   cc -O2 -o bench bench.c -lm
+ *   ./bench [--match] [count] [seed] [cancel_ratio] [replace_ratio] [reuse_ratio] [price_levels]
+ *
+ * The same arguments always produce the same stream.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Count every allocation the list library makes */
+static size_t bench_allocations = 0;
+
+static void* bench_malloc(size_t size)
+{
+    bench_allocations++;
+    return (malloc)(size);
+}
+
+#define malloc bench_malloc
+#include "match.c"
+#undef malloc
+
+/* Book window kept by the replay, so cancel lookups scan a bounded list */
+#define BOOK_WINDOW 1024
+
+typedef struct {
+    uint64_t seed;
+    double cancel_ratio;    /* share of instructions that are CANCEL */
+    double replace_ratio;   /* share of instructions that are CANCEL_REPLACE */
+    double reuse_ratio;     /* chance a new ORDER reuses a cancelled id */
+    float mid_price;
+    float tick;
+    int price_levels;       /* prices spread this many ticks around mid */
+} FeedConfig;
+
+typedef struct {
+    FeedConfig config;
+    uint64_t state;
+    int next_id;
+    int *live;              /* ids of resting orders */
+    int live_count;
+    int *retired;           /* cancelled ids available for reuse */
+    int retired_count;
+} FeedGenerator;
+
+static uint64_t feed_next(FeedGenerator *gen)
+{
+    // xorshift64*
+    gen->state ^= gen->state >> 12;
+    gen->state ^= gen->state << 25;
+    gen->state ^= gen->state >> 27;
+    return gen->state * 0x2545f4914f6cdd1dULL;
+}
+
+static double feed_uniform(FeedGenerator *gen)
+{
+    return (feed_next(gen) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Triangular distribution around the mid price, snapped to the tick */
+static float feed_price(FeedGenerator *gen)
+{
+    double offset = (feed_uniform(gen) + feed_uniform(gen) - 1.0) * gen->config.price_levels;
+    return gen->config.mid_price + (float)(long)offset * gen->config.tick;
+}
+
+static int feed_size(FeedGenerator *gen)
+{
+    return 1 + (int)(feed_next(gen) % 100);
+}
+
+static void feed_init(FeedGenerator *gen, FeedConfig config, int count)
+{
+    gen->config = config;
+    gen->state = config.seed ? config.seed : 1;
+    gen->next_id = 1;
+    gen->live = malloc(count * sizeof(int));
+    gen->retired = malloc(count * sizeof(int));
+    gen->live_count = 0;
+    gen->retired_count = 0;
+}
+
+static void feed_free(FeedGenerator *gen)
+{
+    free(gen->live);
+    free(gen->retired);
+}
+
+/* Remove and return a random resting order id */
+static int feed_take_live(FeedGenerator *gen)
+{
+    int i = (int)(feed_next(gen) % gen->live_count);
+    int id = gen->live[i];
+    gen->live[i] = gen->live[--gen->live_count];
+    return id;
+}
+
+static Instruction feed_instruction(FeedGenerator *gen)
+{
+    double roll = feed_uniform(gen);
+    if (gen->live_count > 0 && roll < gen->config.cancel_ratio) {
+        int id = feed_take_live(gen);
+        gen->retired[gen->retired_count++] = id;
+        return (Instruction){.type = CANCEL, .cancel = {.xid = id}};
+    }
+    if (gen->live_count > 0 && roll < gen->config.cancel_ratio + gen->config.replace_ratio) {
+        int id = gen->live[feed_next(gen) % gen->live_count];
+        return (Instruction){.type = CANCEL_REPLACE, .cancel_replace = {
+            .xr_id = id, .new_price = feed_price(gen), .new_size = feed_size(gen)}};
+    }
+    int id;
+    if (gen->retired_count > 0 && feed_uniform(gen) < gen->config.reuse_ratio) {
+        id = gen->retired[--gen->retired_count];
+    } else {
+        id = gen->next_id++;
+    }
+    gen->live[gen->live_count++] = id;
+    Side side = feed_next(gen) & 1 ? SELL : BUY;
+    return (Instruction){.type = ORDER, .order = {.id = id, .price = feed_price(gen), .size = feed_size(gen), .side = side}};
+}
+
+/* Log-linear histogram: 64 exact buckets, then 32 sub-buckets per power of two */
+#define HIST_SUB_BUCKETS 32
+#define HIST_BUCKETS (2 * HIST_SUB_BUCKETS + 58 * HIST_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} Histogram;
+
+static int hist_index(uint64_t value)
+{
+    if (value < 2 * HIST_SUB_BUCKETS) {
+        return (int)value;
+    }
+    int shift = 63 - __builtin_clzll(value) - 5;
+    return 2 * HIST_SUB_BUCKETS + (shift - 1) * HIST_SUB_BUCKETS + (int)((value >> shift) - HIST_SUB_BUCKETS);
+}
+
+static uint64_t hist_value(int index)
+{
+    if (index < 2 * HIST_SUB_BUCKETS) {
+        return index;
+    }
+    int shift = (index - 2 * HIST_SUB_BUCKETS) / HIST_SUB_BUCKETS + 1;
+    uint64_t sub = (index - 2 * HIST_SUB_BUCKETS) % HIST_SUB_BUCKETS + HIST_SUB_BUCKETS;
+    return sub << shift;
+}
+
+static void hist_record(Histogram *hist, uint64_t value)
+{
+    hist->counts[hist_index(value)]++;
+    hist->total++;
+    if (value > hist->max) hist->max = value;
+}
+
+static uint64_t hist_percentile(Histogram *hist, double percentile)
+{
+    uint64_t target = (uint64_t)(percentile / 100.0 * hist->total + 0.5);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= target) return hist_value(i);
+    }
+    return hist->max;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void *sum_size(void *acc, Instruction instruction)
+{
+    long *total = (long*)acc;
+    if (instruction.type == ORDER) *total += instruction.order.size;
+    return acc;
+}
+
+/* Process one instruction; returns a value so the work is not optimized away */
+static long replay_one(InstructionList **book, Instruction instruction)
+{
+    long total = 0;
+    switch (instruction.type) {
+        case ORDER:
+            *book = Instruction_cons(times2(instruction), *book);
+            break;
+        case CANCEL:
+        case CANCEL_REPLACE: {
+            InstructionList *matches = filter_by_oid(*book, instruction_id(instruction));
+            Instruction_foldl(matches, sum_size, &total);
+            *book = Instruction_cons(instruction, *book);
+            break;
+        }
+    }
+    return total;
+}
+
+/* Replay through the matching engine; returns the number of fills */
+static long replay_match(Instruction *feed, int count, FeedConfig config, Histogram *hist, size_t *allocations)
+{
+    MatchEngine engine;
+    float base_price = config.mid_price - (config.price_levels + 1) * config.tick;
+    match_engine_init(&engine, base_price, config.tick, 2 * config.price_levels + 3, count);
+    long fills = 0;
+    size_t allocations_before = bench_allocations;
+    for (int i = 0; i < count; i++) {
+        uint64_t t0 = now_ns();
+        int events = match_process(&engine, feed[i]);
+        hist_record(hist, now_ns() - t0);
+        for (int k = 0; k < events; k++) {
+            fills += engine.events[k].kind == MATCH_FILL || engine.events[k].kind == MATCH_PARTIAL_FILL;
+        }
+    }
+    *allocations = bench_allocations - allocations_before;
+    match_engine_free(&engine);
+    return fills;
+}
+
+int main(int argc, char **argv)
+{
+    bool match = argc > 1 && strcmp(argv[1], "--match") == 0;
+    if (match) {
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+    int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    FeedConfig config = {
+        .seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 42,
+        .cancel_ratio = argc > 3 ? atof(argv[3]) : 0.30,
+        .replace_ratio = argc > 4 ? atof(argv[4]) : 0.10,
+        .reuse_ratio = argc > 5 ? atof(argv[5]) : 0.05,
+        .mid_price = 100.0f,
+        .tick = 0.01f,
+        .price_levels = argc > 6 ? atoi(argv[6]) : 50,
+    };
+    if (count <= 0) {
+        fprintf(stderr, "usage: %s [--match] [count] [seed] [cancel_ratio] [replace_ratio] [reuse_ratio] [price_levels]\n", argv[0]);
+        return 1;
+    }
+
+    Instruction *feed = malloc(count * sizeof(Instruction));
+    FeedGenerator gen;
+    feed_init(&gen, config, count);
+    int kinds[3] = {0};
+    for (int i = 0; i < count; i++) {
+        feed[i] = feed_instruction(&gen);
+        kinds[feed[i].type]++;
+    }
+    feed_free(&gen);
+
+    static Histogram hist;
+    long checksum = 0;
+    size_t allocations;
+    uint64_t start = now_ns();
+    if (match) {
+        checksum = replay_match(feed, count, config, &hist, &allocations);
+    } else {
+        InstructionList *book = empty_InstructionList;
+        size_t allocations_before = bench_allocations;
+        size_t trim_allocations = 0;
+        for (int i = 0; i < count; i++) {
+            uint64_t t0 = now_ns();
+            checksum += replay_one(&book, feed[i]);
+            hist_record(&hist, now_ns() - t0);
+            // Book maintenance is harness work, so it stays out of the timings and the allocation count
+            if ((i + 1) % BOOK_WINDOW == 0) {
+                size_t trim_before = bench_allocations;
+                book = Instruction_take(book, BOOK_WINDOW);
+                trim_allocations += bench_allocations - trim_before;
+            }
+        }
+        allocations = bench_allocations - allocations_before - trim_allocations;
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    printf("instructions   %d (orders %d, cancels %d, replaces %d)\n", count, kinds[ORDER], kinds[CANCEL], kinds[CANCEL_REPLACE]);
+    printf("seed           %llu\n", (unsigned long long)config.seed);
+    printf("elapsed        %.3f ms\n", elapsed / 1e6);
+    printf("throughput     %.0f instructions/s\n", count / (elapsed / 1e9));
+    printf("latency p50    %llu ns\n", (unsigned long long)hist_percentile(&hist, 50.0));
+    printf("latency p99    %llu ns\n", (unsigned long long)hist_percentile(&hist, 99.0));
+    printf("latency p99.9  %llu ns\n", (unsigned long long)hist_percentile(&hist, 99.9));
+    printf("latency max    %llu ns\n", (unsigned long long)hist.max);
+    printf("allocations    %zu (%.2f per instruction)\n", allocations, (double)allocations / count);
+    printf("%s%ld\n", match ? "fills          " : "checksum       ", checksum);
+    free(feed);
+    return 0;
+}
@@ -0,0 +1,594 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define INGEST_HAVE_IO_URING 1
+#endif
+#endif
+
+#include "order.c"
+
+/*
+ * INSTRUCTION FILE INGEST
+ * =======================
+ *
+ * ingest_file(path, format, func, ctx) reads an instruction file through a
+ * ring of INGEST_BUFFERS buffers kept in flight, so reading the next chunks
+ * overlaps decoding the current one. Each decoded chunk is handed to func as
+ * an InstructionList built with Instruction_from_array, in file order, and
+ * func takes ownership of it.
+ *
+ * Reads go through io_uring when IORING_REGISTER_PROBE reports support for
+ * IORING_OP_READ, otherwise through a reader thread calling pread. Decoding
+ * and list construction run on the calling thread, one buffer at a time.
+ * Programs including this file need to be built with -pthread.
+ *
+ * Formats:
+ * --------
+ * INGEST_BINARY  // An IngestBinaryHeader, then raw Instruction records, as
+ *                // written by ingest_write_binary
+ * INGEST_TEXT    // One instruction per line:
+ *                //   ORDER <id> <price> <size> [BUY|SELL]
+ *                //   CANCEL <xid>
+ *                //   CANCEL_REPLACE <xr_id> <new_price> <new_size>
+ */
+
+#define INGEST_BUFFER_SIZE (1 << 20)
+#define INGEST_BUFFERS 4
+#define INGEST_MAX_LINE 256
+
+/* Leads every binary file, so records of another layout are refused */
+#define INGEST_BINARY_MAGIC "INS1"
+
+typedef struct {
+    char magic[4];
+    uint32_t record_size;
+} IngestBinaryHeader;
+
+typedef enum {
+    INGEST_TEXT,
+    INGEST_BINARY,
+} IngestFormat;
+
+/* Receives each decoded chunk, in file order; batch is a single from_array block that func owns and must free(batch) once */
+typedef void (*IngestFunc)(InstructionList *batch, size_t count, void *ctx);
+
+typedef struct {
+    IngestFormat format;
+    IngestFunc func;
+    void *ctx;
+    char carry[INGEST_MAX_LINE];    // partial record left at the end of a buffer
+    size_t carry_len;
+    bool header_seen;               // binary header read and checked
+    Instruction *batch;
+    size_t batch_len;
+    size_t batch_capacity;
+} IngestDecoder;
+
+static void ingest_push(IngestDecoder *decoder, Instruction instruction) {
+    if (decoder->batch_len == decoder->batch_capacity) {
+        decoder->batch = (Instruction*) list_grow(decoder->batch, &decoder->batch_capacity, sizeof(Instruction));
+    }
+    decoder->batch[decoder->batch_len++] = instruction;
+}
+
+static bool ingest_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Match a keyword that is followed by whitespace or the end of the line */
+static bool ingest_keyword(char **p, const char *keyword) {
+    size_t n = strlen(keyword);
+    if (strncmp(*p, keyword, n) != 0 || !(ingest_is_space((*p)[n]) || (*p)[n] == '\0')) {
+        return false;
+    }
+    *p += n;
+    return true;
+}
+
+/* Parse a whitespace-separated int field */
+static bool ingest_int(char **p, int *value) {
+    if (!ingest_is_space(**p)) {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    long parsed = strtol(*p, &end, 10);
+    if (end == *p || errno != 0 || parsed < INT_MIN || parsed > INT_MAX
+        || !(ingest_is_space(*end) || *end == '\0')) {
+        return false;
+    }
+    *value = (int) parsed;
+    *p = end;
+    return true;
+}
+
+/* Parse a whitespace-separated float field */
+static bool ingest_float(char **p, float *value) {
+    if (!ingest_is_space(**p)) {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    float parsed = strtof(*p, &end);
+    if (end == *p || errno != 0 || !(ingest_is_space(*end) || *end == '\0')) {
+        return false;
+    }
+    *value = parsed;
+    *p = end;
+    return true;
+}
+
+/* Parse one NUL-terminated text line; blank lines are skipped */
+static bool ingest_parse_line(IngestDecoder *decoder, char *line) {
+    char *p = line;
+    while (ingest_is_space(*p)) p++;
+    if (*p == '\0') {
+        return true;
+    }
+    Instruction instruction = {0};
+    bool ok;
+    if (ingest_keyword(&p, "CANCEL_REPLACE")) {
+        instruction.type = CANCEL_REPLACE;
+        ok = ingest_int(&p, &instruction.cancel_replace.xr_id)
+            && ingest_float(&p, &instruction.cancel_replace.new_price)
+            && ingest_int(&p, &instruction.cancel_replace.new_size);
+    } else if (ingest_keyword(&p, "CANCEL")) {
+        instruction.type = CANCEL;
+        ok = ingest_int(&p, &instruction.cancel.xid);
+    } else if (ingest_keyword(&p, "ORDER")) {
+        instruction.type = ORDER;
+        ok = ingest_int(&p, &instruction.order.id)
+            && ingest_float(&p, &instruction.order.price)
+            && ingest_int(&p, &instruction.order.size);
+        while (ok && ingest_is_space(*p)) p++;
+        if (ok && *p != '\0') {
+            if (ingest_keyword(&p, "SELL")) {
+                instruction.order.side = SELL;
+            } else if (!ingest_keyword(&p, "BUY")) {
+                ok = false;
+            }
+        }
+    } else {
+        return false;
+    }
+    while (ok && ingest_is_space(*p)) p++;
+    if (!ok || *p != '\0') {
+        return false;
+    }
+    ingest_push(decoder, instruction);
+    return true;
+}
+
+static bool ingest_decode_text(IngestDecoder *decoder, const char *data, size_t len) {
+    char line[INGEST_MAX_LINE + 1];
+    size_t i = 0;
+    while (i < len) {
+        const char *newline = memchr(data + i, '\n', len - i);
+        size_t n = newline ? (size_t)(newline - (data + i)) : len - i;
+        if (decoder->carry_len + n > INGEST_MAX_LINE) {
+            return false;
+        }
+        if (!newline) {
+            memcpy(decoder->carry + decoder->carry_len, data + i, n);
+            decoder->carry_len += n;
+            break;
+        }
+        memcpy(line, decoder->carry, decoder->carry_len);
+        memcpy(line + decoder->carry_len, data + i, n);
+        line[decoder->carry_len + n] = '\0';
+        decoder->carry_len = 0;
+        if (!ingest_parse_line(decoder, line)) {
+            return false;
+        }
+        i += n + 1;
+    }
+    return true;
+}
+
+/* Raw records are checked the way the text parser checks its fields */
+static bool ingest_valid_record(Instruction instruction) {
+    switch (instruction.type) {
+        case ORDER: return instruction.order.side == BUY || instruction.order.side == SELL;
+        case CANCEL:
+        case CANCEL_REPLACE: return true;
+    }
+    return false;
+}
+
+static bool ingest_decode_binary(IngestDecoder *decoder, const char *data, size_t len) {
+    if (!decoder->header_seen) {
+        size_t n = sizeof(IngestBinaryHeader) - decoder->carry_len;
+        if (n > len) n = len;
+        memcpy(decoder->carry + decoder->carry_len, data, n);
+        decoder->carry_len += n;
+        data += n;
+        len -= n;
+        if (decoder->carry_len < sizeof(IngestBinaryHeader)) {
+            return true;
+        }
+        IngestBinaryHeader header;
+        memcpy(&header, decoder->carry, sizeof(header));
+        decoder->carry_len = 0;
+        if (memcmp(header.magic, INGEST_BINARY_MAGIC, 4) != 0 || header.record_size != sizeof(Instruction)) {
+            return false;
+        }
+        decoder->header_seen = true;
+    }
+    size_t i = 0;
+    if (decoder->carry_len > 0) {
+        size_t n = sizeof(Instruction) - decoder->carry_len;
+        if (n > len) n = len;
+        memcpy(decoder->carry + decoder->carry_len, data, n);
+        decoder->carry_len += n;
+        i = n;
+        if (decoder->carry_len < sizeof(Instruction)) {
+            return true;
+        }
+        Instruction instruction;
+        memcpy(&instruction, decoder->carry, sizeof(Instruction));
+        if (!ingest_valid_record(instruction)) {
+            return false;
+        }
+        ingest_push(decoder, instruction);
+        decoder->carry_len = 0;
+    }
+    size_t records = (len - i) / sizeof(Instruction);
+    while (decoder->batch_len + records > decoder->batch_capacity) {
+        decoder->batch = (Instruction*) list_grow(decoder->batch, &decoder->batch_capacity, sizeof(Instruction));
+    }
+    memcpy(decoder->batch + decoder->batch_len, data + i, records * sizeof(Instruction));
+    for (size_t k = 0; k < records; k++) {
+        if (!ingest_valid_record(decoder->batch[decoder->batch_len + k])) {
+            return false;
+        }
+    }
+    decoder->batch_len += records;
+    i += records * sizeof(Instruction);
+    memcpy(decoder->carry, data + i, len - i);
+    decoder->carry_len = len - i;
+    return true;
+}
+
+/* Decode one filled buffer and hand the resulting chunk to the consumer */
+static bool ingest_decode(IngestDecoder *decoder, const char *data, size_t len) {
+    bool ok = decoder->format == INGEST_TEXT
+        ? ingest_decode_text(decoder, data, len)
+        : ingest_decode_binary(decoder, data, len);
+    if (ok && decoder->batch_len > 0) {
+        decoder->func(Instruction_from_array(decoder->batch, decoder->batch_len), decoder->batch_len, decoder->ctx);
+        decoder->batch_len = 0;
+    }
+    return ok;
+}
+
+/* Flush whatever is left once the file is exhausted */
+static bool ingest_finish(IngestDecoder *decoder) {
+    if (decoder->format == INGEST_BINARY) {
+        return decoder->header_seen && decoder->carry_len == 0;   // else missing header or truncated record
+    }
+    if (decoder->carry_len == 0) {
+        return true;
+    }
+    const char newline = '\n';
+    return ingest_decode(decoder, &newline, 1);
+}
+
+/* Read until the buffer is full or the file ends; returns bytes read or -1 */
+static ssize_t ingest_pread_full(int fd, char *data, size_t size, off_t offset) {
+    size_t filled = 0;
+    while (filled < size) {
+        ssize_t n = pread(fd, data + filled, size - filled, offset + (off_t) filled);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) break;
+        filled += (size_t) n;
+    }
+    return (ssize_t) filled;
+}
+
+// Reader thread fallback
+
+typedef struct {
+    char *data;
+    ssize_t len;
+    bool full;
+} IngestSlot;
+
+typedef struct {
+    int fd;
+    IngestSlot slots[INGEST_BUFFERS];
+    bool stop;
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+    pthread_cond_t drained;
+} IngestReader;
+
+static void *ingest_reader_main(void *arg) {
+    IngestReader *reader = (IngestReader*) arg;
+    off_t offset = 0;
+    for (int i = 0; ; i = (i + 1) % INGEST_BUFFERS) {
+        IngestSlot *slot = &reader->slots[i];
+        pthread_mutex_lock(&reader->lock);
+        while (slot->full && !reader->stop) {
+            pthread_cond_wait(&reader->drained, &reader->lock);
+        }
+        bool stop = reader->stop;
+        pthread_mutex_unlock(&reader->lock);
+        if (stop) {
+            return NULL;
+        }
+        ssize_t n = ingest_pread_full(reader->fd, slot->data, INGEST_BUFFER_SIZE, offset);
+        pthread_mutex_lock(&reader->lock);
+        slot->len = n;
+        slot->full = true;
+        pthread_cond_signal(&reader->filled);
+        pthread_mutex_unlock(&reader->lock);
+        if (n < INGEST_BUFFER_SIZE) {
+            return NULL;
+        }
+        offset += n;
+    }
+}
+
+static bool ingest_with_thread(int fd, char *buffers, IngestDecoder *decoder) {
+    IngestReader reader = { .fd = fd, .stop = false };
+    for (int i = 0; i < INGEST_BUFFERS; i++) {
+        reader.slots[i] = (IngestSlot){ buffers + (size_t) i * INGEST_BUFFER_SIZE, 0, false };
+    }
+    pthread_mutex_init(&reader.lock, NULL);
+    pthread_cond_init(&reader.filled, NULL);
+    pthread_cond_init(&reader.drained, NULL);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ingest_reader_main, &reader) != 0) {
+        return false;
+    }
+    bool ok = true;
+    for (int i = 0; ; i = (i + 1) % INGEST_BUFFERS) {
+        IngestSlot *slot = &reader.slots[i];
+        pthread_mutex_lock(&reader.lock);
+        while (!slot->full) {
+            pthread_cond_wait(&reader.filled, &reader.lock);
+        }
+        pthread_mutex_unlock(&reader.lock);
+        ok = slot->len >= 0 && ingest_decode(decoder, slot->data, (size_t) slot->len);
+        bool last = !ok || slot->len < INGEST_BUFFER_SIZE;
+        pthread_mutex_lock(&reader.lock);
+        slot->full = false;
+        reader.stop = last;
+        pthread_cond_signal(&reader.drained);
+        pthread_mutex_unlock(&reader.lock);
+        if (last) break;
+    }
+    pthread_join(thread, NULL);
+    pthread_mutex_destroy(&reader.lock);
+    pthread_cond_destroy(&reader.filled);
+    pthread_cond_destroy(&reader.drained);
+    return ok;
+}
+
+#ifdef INGEST_HAVE_IO_URING
+
+// io_uring, driven through the raw system calls
+
+typedef struct {
+    int fd;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} IngestRing;
+
+/* Kernels 5.1-5.5 set up rings but have no IORING_OP_READ (nor the probe) */
+static bool ingest_ring_supports_read(int fd) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe*) list_alloc(size);
+    memset(probe, 0, size);
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) >= 0
+        && probe->last_op >= IORING_OP_READ
+        && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return supported;
+}
+
+static bool ingest_ring_init(IngestRing *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return false;
+    }
+    if (!ingest_ring_supports_read(ring->fd)) {
+        close(ring->fd);
+        return false;
+    }
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = single ? ring->sq_ring
+        : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        close(ring->fd);
+        return false;
+    }
+    char *sq = (char*) ring->sq_ring;
+    char *cq = (char*) ring->cq_ring;
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return true;
+}
+
+static void ingest_ring_free(IngestRing *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+/* Queue a read and submit it right away */
+static bool ingest_ring_read(IngestRing *ring, int fd, char *data, size_t len, off_t offset, int slot) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long) data;
+    sqe->len = (unsigned) len;
+    sqe->off = (unsigned long long) offset;
+    sqe->user_data = (unsigned long long) slot;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) == 1;
+}
+
+/* Wait for one completion */
+static bool ingest_ring_wait(IngestRing *ring, int *slot, int *res) {
+    unsigned head = *ring->cq_head;
+    while (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        if (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+    struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+    *slot = (int) cqe->user_data;
+    *res = cqe->res;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+typedef struct {
+    off_t offset;
+    size_t filled;
+    bool done;
+} IngestRequest;
+
+/* Keep every buffer in flight and decode them in file order; *drained is false if reads may still be in flight */
+static bool ingest_with_ring(IngestRing *ring, int fd, char *buffers, IngestDecoder *decoder, bool *drained) {
+    IngestRequest requests[INGEST_BUFFERS];
+    int in_flight = 0;
+    off_t next_offset = 0;
+    bool ok = true;
+    for (int i = 0; i < INGEST_BUFFERS && ok; i++) {
+        requests[i] = (IngestRequest){ next_offset, 0, false };
+        ok = ingest_ring_read(ring, fd, buffers + (size_t) i * INGEST_BUFFER_SIZE, INGEST_BUFFER_SIZE, next_offset, i);
+        in_flight += ok;
+        next_offset += INGEST_BUFFER_SIZE;
+    }
+    for (int i = 0; ok; i = (i + 1) % INGEST_BUFFERS) {
+        IngestRequest *request = &requests[i];
+        while (ok && !request->done) {
+            int slot, res;
+            ok = ingest_ring_wait(ring, &slot, &res);
+            if (!ok) break;
+            in_flight--;
+            ok = res >= 0;
+            if (!ok) break;
+            IngestRequest *completed = &requests[slot];
+            completed->filled += (size_t) res;
+            if (res == 0 || completed->filled == INGEST_BUFFER_SIZE) {
+                completed->done = true;
+            } else {
+                // Short read: ask for the rest of this buffer
+                ok = ingest_ring_read(ring, fd, buffers + (size_t) slot * INGEST_BUFFER_SIZE + completed->filled,
+                    INGEST_BUFFER_SIZE - completed->filled, completed->offset + (off_t) completed->filled, slot);
+                in_flight += ok;
+            }
+        }
+        if (!ok) break;
+        char *data = buffers + (size_t) i * INGEST_BUFFER_SIZE;
+        ok = ingest_decode(decoder, data, request->filled);
+        if (!ok || request->filled < INGEST_BUFFER_SIZE) break;
+        *request = (IngestRequest){ next_offset, 0, false };
+        ok = ingest_ring_read(ring, fd, data, INGEST_BUFFER_SIZE, next_offset, i);
+        in_flight += ok;
+        next_offset += INGEST_BUFFER_SIZE;
+    }
+    // Reads past the end of the file finish at once; reap them before the buffers go away
+    int slot, res;
+    while (in_flight > 0 && ingest_ring_wait(ring, &slot, &res)) {
+        in_flight--;
+    }
+    *drained = in_flight == 0;
+    return ok;
+}
+
+#endif
+
+/* Read an instruction file and pass it to func chunk by chunk */
+bool ingest_file(const char *path, IngestFormat format, IngestFunc func, void *ctx) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char *buffers = (char*) list_alloc((size_t) INGEST_BUFFERS * INGEST_BUFFER_SIZE);
+    IngestDecoder decoder = { .format = format, .func = func, .ctx = ctx, .carry_len = 0, .header_seen = false, .batch_len = 0 };
+    decoder.batch_capacity = 1024;
+    decoder.batch = (Instruction*) list_alloc(decoder.batch_capacity * sizeof(Instruction));
+    bool ok;
+    bool drained = true;
+#ifdef INGEST_HAVE_IO_URING
+    IngestRing ring;
+    if (ingest_ring_init(&ring, INGEST_BUFFERS * 2)) {
+        ok = ingest_with_ring(&ring, fd, buffers, &decoder, &drained);
+        ingest_ring_free(&ring);
+    } else {
+        ok = ingest_with_thread(fd, buffers, &decoder);
+    }
+#else
+    ok = ingest_with_thread(fd, buffers, &decoder);
+#endif
+    ok = ok && ingest_finish(&decoder);
+    free(decoder.batch);
+    if (drained) {
+        free(buffers);   // else leaked, since the kernel may still write into them
+    }
+    close(fd);
+    return ok;
+}
+
+/* Write a list as a header and raw Instruction records for INGEST_BINARY */
+bool ingest_write_binary(const char *path, InstructionList *list) {
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        return false;
+    }
+    IngestBinaryHeader header = { INGEST_BINARY_MAGIC, sizeof(Instruction) };
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    for (; list && ok; list = list->rest) {
+        ok = fwrite(&list->head, sizeof(Instruction), 1, out) == 1;
+    }
+    return fclose(out) == 0 && ok;
+}
@@ -5,6 +5,12 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* 
  * GENERIC IMMUTABLE LIST LIBRARY
@@ -29,22 +35,32 @@
  * - TypeNamePredicateFunc           // Function pointer: (Type, void*) -> bool
  * - TypeNameZipWithFunc             // Function pointer: (Type, Type) -> Type
  * - TypeNamePartition               // Struct with passed and failed lists
+ * - TypeNameSeq                     // Catenable sequence of lists
+ * - TypeNameSnapshot                // Lists restored from a checkpoint
  * 
  * Basic Operations:
  * -----------------
  * TypeName_cons(head, rest)         // Prepend element to list
  * TypeName_list(count, ...)         // Create list from varargs
+ * TypeName_from_array(values, count) // Create in-order list in one allocation
  * TypeName_head(list)               // Get first element
  * TypeName_tail(list)               // Get rest of list
  * TypeName_is_empty(list)           // Check if empty
  * TypeName_length(list)             // Count elements
  * TypeName_nth(list, index, *result) // Get element at index (returns bool)
+ * TypeName_equal(list1, list2)      // Structural equality (pointer test when interned)
+ * 
+ * Arrays:
+ * -------
+ * TypeName_to_array(list, *count)   // Copy into a new array (caller frees)
+ * TypeName_copy_to(list, out, cap)  // Copy up to cap elements, returns count
  * 
  * Building Lists:
  * ---------------
  * TypeName_append(list, value)      // Add element to end
  * TypeName_concat(list1, list2)     // Join two lists
  * TypeName_reverse(list)            // Reverse order
+ * TypeName_compact(list)            // Copy into one block in traversal order
  * 
  * Transforming:
  * -------------
@@ -52,6 +68,13 @@
  * TypeName_filter(list, func, ctx)  // Keep elements matching predicate
  * TypeName_flatmap(list, func)      // Map then flatten results
  * 
+ * Catenable Sequences:
+ * ---------------------
+ * TypeName_seq_of(list)             // Wrap a list as a sequence (no copy)
+ * TypeName_seq_concat(seq1, seq2)   // Join two sequences in O(1)
+ * TypeName_seq_uncons(seq, *head, *rest) // Split off first element (returns bool)
+ * TypeName_seq_to_list(seq)         // Flatten to a list, linear in its length
+ * 
  * Folding/Reducing:
  * -----------------
  * TypeName_foldl(list, func, acc)   // Fold left (accumulate left-to-right)
@@ -75,8 +98,161 @@
  * TypeName_zipWith(list1, list2, func)     // Combine two lists pairwise with func(a,b)->Type
  * TypeName_partition(list, pred, ctx)      // Split into passed/failed lists
  * 
+ * Hash-consing:
+ * --------------
+ * TypeName_set_interning(enabled)   // Route every cons through the intern table
+ * TypeName_intern(head, rest)       // Hash-consed cons, regardless of the mode
+ * TypeName_intern_clear()           // Drop the intern table (nodes stay valid)
+ * 
+ * With interning on, a node equal to an existing (head, rest) pair is reused,
+ * so map, filter, take and friends share identical suffixes instead of
+ * allocating them again, and equal interned lists are the same pointer.
+ * Heads are compared byte for byte, so build values with designated
+ * initializers or memset so that unused union members and padding are zero.
+ * 
+ * Checkpointing:
+ * --------------
+ * TypeName_checkpoint(path, roots, count)  // Write lists to a binary node table (returns bool)
+ * TypeName_restore(path, *snapshot)        // Read a checkpoint into one allocation (returns bool)
+ * TypeName_restore_mmap(path, *snapshot)   // Restore in place from an mmap'd checkpoint (returns bool)
+ * TypeName_snapshot_release(*snapshot)     // Free the memory behind restored lists
+ * 
+ * A checkpoint stores every distinct node reachable from the roots exactly
+ * once, so tails shared through drop, concat or dropWhile stay shared after
+ * a restore. The file is written to path.tmp, synced and renamed over path,
+ * so a crash mid-write leaves the previous checkpoint intact. Nodes are
+ * written tail first and each record keeps the distance
+ * back to its rest node instead of a pointer. Type is copied byte for byte,
+ * so it must be plain data. Restored nodes live in a single block owned by
+ * the TypeNameSnapshot and must not be freed one by one.
+ * 
  */
 
+/* Hint the cache to fetch the next node while the current one is processed */
+#if defined(__GNUC__) || defined(__clang__)
+#define LIST_PREFETCH(ptr) __builtin_prefetch((ptr), 0, 3)
+#else
+#define LIST_PREFETCH(ptr) ((void)(ptr))
+#endif
+
+/* Allocate or exit, shared by the non-cons allocations below */
+static void* list_alloc(size_t size) {
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+/* Double the capacity of a growable array, or exit */
+static void* list_grow(void* buffer, size_t* capacity, size_t size) {
+    *capacity *= 2;
+    void* grown = realloc(buffer, *capacity * size);
+    if (!grown) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return grown;
+}
+
+/* FNV-1a over the raw bytes of a value */
+static size_t list_bytes_hash(const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return (size_t) hash;
+}
+
+/* Open-addressing map from node pointer to node index */
+typedef struct {
+    const void** keys;
+    size_t* values;
+    size_t capacity;
+    size_t count;
+} ListPtrMap;
+
+static size_t list_ptr_hash(const void* ptr) {
+    uint64_t x = (uint64_t)(uintptr_t)ptr;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+static void list_ptrmap_init(ListPtrMap* map, size_t capacity) {
+    map->capacity = capacity;
+    map->count = 0;
+    map->keys = (const void**) list_alloc(capacity * sizeof(*map->keys));
+    map->values = (size_t*) list_alloc(capacity * sizeof(*map->values));
+    memset(map->keys, 0, capacity * sizeof(*map->keys));
+}
+
+static void list_ptrmap_free(ListPtrMap* map) {
+    free(map->keys);
+    free(map->values);
+}
+
+static bool list_ptrmap_get(ListPtrMap* map, const void* key, size_t* value) {
+    size_t mask = map->capacity - 1;
+    for (size_t i = list_ptr_hash(key) & mask; map->keys[i]; i = (i + 1) & mask) {
+        if (map->keys[i] == key) {
+            if (value) *value = map->values[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static void list_ptrmap_put(ListPtrMap* map, const void* key, size_t value) {
+    if ((map->count + 1) * 2 > map->capacity) {
+        ListPtrMap grown;
+        list_ptrmap_init(&grown, map->capacity * 2);
+        for (size_t i = 0; i < map->capacity; i++) {
+            if (map->keys[i]) list_ptrmap_put(&grown, map->keys[i], map->values[i]);
+        }
+        list_ptrmap_free(map);
+        *map = grown;
+    }
+    size_t mask = map->capacity - 1;
+    size_t i = list_ptr_hash(key) & mask;
+    while (map->keys[i] && map->keys[i] != key) {
+        i = (i + 1) & mask;
+    }
+    if (!map->keys[i]) map->count++;
+    map->keys[i] = key;
+    map->values[i] = value;
+}
+
+/* Checkpoint file header, followed by the root table and the node table */
+#define LIST_CHECKPOINT_MAGIC "LCK1"
+
+typedef struct {
+    char magic[4];
+    uint32_t node_size;
+    uint64_t node_count;
+    uint64_t root_count;
+} ListCheckpointHeader;
+
+/* Node table starts on a cache line so an mmap'd file can be used in place */
+static size_t list_checkpoint_nodes_offset(uint64_t root_count) {
+    size_t offset = sizeof(ListCheckpointHeader) + root_count * sizeof(uint64_t);
+    return (offset + 63) & ~(size_t)63;
+}
+
+/* Check the header, and that the tables it describes fit in the file */
+static bool list_checkpoint_valid(const ListCheckpointHeader* header, size_t node_size, size_t file_size) {
+    if (memcmp(header->magic, LIST_CHECKPOINT_MAGIC, 4) != 0
+        || header->node_size != node_size
+        || header->root_count > (file_size - sizeof(ListCheckpointHeader)) / sizeof(uint64_t)) {
+        return false;
+    }
+    size_t offset = list_checkpoint_nodes_offset(header->root_count);
+    return offset <= file_size && header->node_count <= (file_size - offset) / node_size;
+}
+
 // Macro to define a generic immutable list type and its operations
 #define DEFINE_LIST(Type, TypeName) \
 \
@@ -89,9 +265,8 @@ typedef struct TypeName##List { \
 /* The empty list (shared singleton) */ \
 TypeName##List* empty_##TypeName##List = NULL; \
 \
-/* Create a new list node (list construction operation) */ \
-/* Returns a new list with value at the head, followed by rest */ \
-TypeName##List* TypeName##_cons(Type head, TypeName##List* rest) { \
+/* Allocate a fresh list node */ \
+TypeName##List* TypeName##_alloc_node(Type head, TypeName##List* rest) { \
     TypeName##List* list = (TypeName##List*) malloc(sizeof(TypeName##List)); \
     if (!list) { \
         fprintf(stderr, "Out of memory\n"); \
@@ -102,6 +277,73 @@ TypeName##List* TypeName##_cons(Type head, TypeName##List* rest) { \
     return list; \
 } \
 \
+/* Intern table of hash-consed nodes, keyed on (head bytes, rest pointer) */ \
+typedef struct { \
+    TypeName##List** slots; \
+    size_t capacity; \
+    size_t count; \
+    bool enabled; \
+} TypeName##InternTable; \
+\
+TypeName##InternTable TypeName##_interned = { NULL, 0, 0, false }; \
+\
+size_t TypeName##_intern_hash(const Type* head, const TypeName##List* rest) { \
+    return list_bytes_hash(head, sizeof(Type)) ^ list_ptr_hash(rest); \
+} \
+\
+/* Return the existing node equal to (head, rest), or intern a new one */ \
+TypeName##List* TypeName##_intern(Type head, TypeName##List* rest) { \
+    TypeName##InternTable* table = &TypeName##_interned; \
+    if ((table->count + 1) * 2 > table->capacity) { \
+        size_t capacity = table->capacity ? table->capacity * 2 : 1024; \
+        TypeName##List** slots = (TypeName##List**) list_alloc(capacity * sizeof(*slots)); \
+        memset(slots, 0, capacity * sizeof(*slots)); \
+        for (size_t i = 0; i < table->capacity; i++) { \
+            TypeName##List* node = table->slots[i]; \
+            if (!node) continue; \
+            size_t j = TypeName##_intern_hash(&node->head, node->rest) & (capacity - 1); \
+            while (slots[j]) j = (j + 1) & (capacity - 1); \
+            slots[j] = node; \
+        } \
+        free(table->slots); \
+        table->slots = slots; \
+        table->capacity = capacity; \
+    } \
+    size_t mask = table->capacity - 1; \
+    size_t i = TypeName##_intern_hash(&head, rest) & mask; \
+    for (; table->slots[i]; i = (i + 1) & mask) { \
+        TypeName##List* node = table->slots[i]; \
+        if (node->rest == rest && memcmp(&node->head, &head, sizeof(Type)) == 0) { \
+            return node; \
+        } \
+    } \
+    table->slots[i] = TypeName##_alloc_node(head, rest); \
+    table->count++; \
+    return table->slots[i]; \
+} \
+\
+/* Turn hash-consing on or off for every list built through cons */ \
+void TypeName##_set_interning(bool enabled) { \
+    TypeName##_interned.enabled = enabled; \
+} \
+\
+/* Forget all interned nodes; the nodes themselves stay valid */ \
+void TypeName##_intern_clear(void) { \
+    free(TypeName##_interned.slots); \
+    TypeName##_interned.slots = NULL; \
+    TypeName##_interned.capacity = 0; \
+    TypeName##_interned.count = 0; \
+} \
+\
+/* Create a new list node (list construction operation) */ \
+/* Returns a new list with value at the head, followed by rest */ \
+TypeName##List* TypeName##_cons(Type head, TypeName##List* rest) { \
+    if (TypeName##_interned.enabled) { \
+        return TypeName##_intern(head, rest); \
+    } \
+    return TypeName##_alloc_node(head, rest); \
+} \
+\
 /* Variadic list constructor */ \
 TypeName##List* TypeName##_list(int count, ...) { \
     TypeName##List *l = NULL; \
@@ -115,6 +357,41 @@ TypeName##List* TypeName##_list(int count, ...) { \
     return l; \
 } \
 \
+/* Build an in-order list whose nodes share one contiguous allocation */ \
+/* The nodes bypass the intern table and cannot be freed one by one */ \
+TypeName##List* TypeName##_from_array(const Type* values, size_t count) { \
+    if (count == 0) { \
+        return empty_##TypeName##List; \
+    } \
+    TypeName##List* nodes = (TypeName##List*) list_alloc(count * sizeof(TypeName##List)); \
+    for (size_t i = 0; i < count; i++) { \
+        nodes[i].head = values[i]; \
+        nodes[i].rest = &nodes[i + 1]; \
+    } \
+    nodes[count - 1].rest = empty_##TypeName##List; \
+    return nodes; \
+} \
+\
+/* Copy up to capacity elements into out; returns the number copied */ \
+size_t TypeName##_copy_to(TypeName##List* list, Type* out, size_t capacity) { \
+    size_t count = 0; \
+    for (; list && count < capacity; list = list->rest) { \
+        out[count++] = list->head; \
+    } \
+    return count; \
+} \
+\
+/* Copy the list into a new array sized from its length; caller frees it */ \
+Type* TypeName##_to_array(TypeName##List* list, size_t* count) { \
+    size_t length = 0; \
+    for (TypeName##List* node = list; node; node = node->rest) { \
+        length++; \
+    } \
+    Type* values = (Type*) list_alloc(length * sizeof(Type)); \
+    *count = TypeName##_copy_to(list, values, length); \
+    return values; \
+} \
+\
 /* Get the head (first element) of the list */ \
 Type TypeName##_head(TypeName##List* list) { \
     if (!list) { \
@@ -148,6 +425,37 @@ int TypeName##_length(TypeName##List* list) { \
     return count; \
 } \
 \
+/* Structural equality; interned lists compare equal by pointer alone */ \
+bool TypeName##_equal(TypeName##List* list1, TypeName##List* list2) { \
+    while (list1 != list2) { \
+        if (!list1 || !list2 || memcmp(&list1->head, &list2->head, sizeof(Type)) != 0) { \
+            return false; \
+        } \
+        list1 = list1->rest; \
+        list2 = list2->rest; \
+    } \
+    return true; \
+} \
+\
+/* Copy a list into one contiguous block laid out in traversal order */ \
+/* The copy shares nothing with the original, which stays valid */ \
+TypeName##List* TypeName##_compact(TypeName##List* list) { \
+    size_t count = 0; \
+    for (TypeName##List* node = list; node; node = node->rest) { \
+        count++; \
+    } \
+    if (count == 0) { \
+        return empty_##TypeName##List; \
+    } \
+    TypeName##List* nodes = (TypeName##List*) list_alloc(count * sizeof(TypeName##List)); \
+    for (size_t i = 0; i < count; i++, list = list->rest) { \
+        nodes[i].head = list->head; \
+        nodes[i].rest = &nodes[i + 1]; \
+    } \
+    nodes[count - 1].rest = empty_##TypeName##List; \
+    return nodes; \
+} \
+\
 /* Append an element to the end (creates entirely new list) */ \
 TypeName##List* TypeName##_append(TypeName##List* list, Type value) { \
     if (TypeName##_is_empty(list)) { \
@@ -198,10 +506,11 @@ typedef void* (*TypeName##FoldFunc)(void*, Type); \
 \
 /* Fold left (reduce) - accumulate from left to right */ \
 void* TypeName##_foldl(TypeName##List* list, TypeName##FoldFunc func, void* acc) { \
-    if (TypeName##_is_empty(list)) { \
-        return acc; \
+    for (; list; list = list->rest) { \
+        LIST_PREFETCH(list->rest); \
+        acc = func(acc, list->head); \
     } \
-    return TypeName##_foldl(TypeName##_tail(list), func, func(acc, TypeName##_head(list))); \
+    return acc; \
 } \
 \
 /* Fold right - accumulate from right to left */ \
@@ -236,50 +545,158 @@ TypeName##List* TypeName##_concat(TypeName##List* list1, TypeName##List* list2)
     return TypeName##_cons(TypeName##_head(list1), TypeName##_concat(TypeName##_tail(list1), list2)); \
 } \
 \
+/* Catenable sequence: a leaf holds a list, a join node holds two sequences */ \
+typedef struct TypeName##Seq { \
+    TypeName##List* list; \
+    struct TypeName##Seq* left; \
+    struct TypeName##Seq* right; \
+} TypeName##Seq; \
+\
+/* The empty sequence */ \
+TypeName##Seq* empty_##TypeName##Seq = NULL; \
+\
+/* Wrap a list as a sequence without copying it */ \
+TypeName##Seq* TypeName##_seq_of(TypeName##List* list) { \
+    if (TypeName##_is_empty(list)) { \
+        return empty_##TypeName##Seq; \
+    } \
+    TypeName##Seq* seq = (TypeName##Seq*) list_alloc(sizeof(TypeName##Seq)); \
+    seq->list = list; \
+    seq->left = seq->right = NULL; \
+    return seq; \
+} \
+\
+/* Check if sequence is empty */ \
+bool TypeName##_seq_is_empty(TypeName##Seq* seq) { \
+    return seq == NULL; \
+} \
+\
+/* Concatenate two sequences in O(1) */ \
+TypeName##Seq* TypeName##_seq_concat(TypeName##Seq* seq1, TypeName##Seq* seq2) { \
+    if (TypeName##_seq_is_empty(seq1)) { \
+        return seq2; \
+    } \
+    if (TypeName##_seq_is_empty(seq2)) { \
+        return seq1; \
+    } \
+    TypeName##Seq* seq = (TypeName##Seq*) list_alloc(sizeof(TypeName##Seq)); \
+    seq->list = empty_##TypeName##List; \
+    seq->left = seq1; \
+    seq->right = seq2; \
+    return seq; \
+} \
+\
+/* Split off the first element; rotates left-nested joins, amortized O(1) */ \
+bool TypeName##_seq_uncons(TypeName##Seq* seq, Type* head, TypeName##Seq** rest) { \
+    if (TypeName##_seq_is_empty(seq)) { \
+        return false; \
+    } \
+    while (seq->left && seq->left->left) { \
+        seq = TypeName##_seq_concat(seq->left->left, TypeName##_seq_concat(seq->left->right, seq->right)); \
+    } \
+    TypeName##Seq* leaf = seq->left ? seq->left : seq; \
+    TypeName##Seq* right = seq->left ? seq->right : empty_##TypeName##Seq; \
+    *head = leaf->list->head; \
+    *rest = TypeName##_seq_concat(TypeName##_seq_of(leaf->list->rest), right); \
+    return true; \
+} \
+\
+/* Collect the leaves of a sequence in order */ \
+TypeName##Seq** TypeName##_seq_leaves(TypeName##Seq* seq, size_t* count) { \
+    size_t depth = 0, stack_capacity = 64, leaf_capacity = 64; \
+    TypeName##Seq** stack = (TypeName##Seq**) list_alloc(stack_capacity * sizeof(*stack)); \
+    TypeName##Seq** leaves = (TypeName##Seq**) list_alloc(leaf_capacity * sizeof(*leaves)); \
+    *count = 0; \
+    if (seq) stack[depth++] = seq; \
+    while (depth > 0) { \
+        seq = stack[--depth]; \
+        if (seq->left) { \
+            if (depth + 2 > stack_capacity) { \
+                stack = (TypeName##Seq**) list_grow(stack, &stack_capacity, sizeof(*stack)); \
+            } \
+            stack[depth++] = seq->right; \
+            stack[depth++] = seq->left; \
+        } else { \
+            if (*count == leaf_capacity) { \
+                leaves = (TypeName##Seq**) list_grow(leaves, &leaf_capacity, sizeof(*leaves)); \
+            } \
+            leaves[(*count)++] = seq; \
+        } \
+    } \
+    free(stack); \
+    return leaves; \
+} \
+\
+/* Flatten a sequence into a list; copies every leaf but the last, which is shared */ \
+TypeName##List* TypeName##_seq_to_list(TypeName##Seq* seq) { \
+    size_t count; \
+    TypeName##Seq** leaves = TypeName##_seq_leaves(seq, &count); \
+    if (count == 0) { \
+        free(leaves); \
+        return empty_##TypeName##List; \
+    } \
+    TypeName##List* list = leaves[count - 1]->list; \
+    for (size_t i = count - 1; i > 0; i--) { \
+        list = TypeName##_concat(leaves[i - 1]->list, list); \
+    } \
+    free(leaves); \
+    return list; \
+} \
+\
 /* Flatten a list of lists */ \
 typedef TypeName##List* (*TypeName##FlatMapFunc)(Type); \
 \
 TypeName##List* TypeName##_flatmap(TypeName##List* list, TypeName##FlatMapFunc func) { \
-    if (TypeName##_is_empty(list)) { \
-        return empty_##TypeName##List; \
+    size_t count = 0, capacity = 64; \
+    TypeName##List** parts = (TypeName##List**) list_alloc(capacity * sizeof(*parts)); \
+    for (; list; list = list->rest) { \
+        if (count == capacity) { \
+            parts = (TypeName##List**) list_grow(parts, &capacity, sizeof(*parts)); \
+        } \
+        parts[count++] = func(list->head); \
     } \
-    return TypeName##_concat(func(TypeName##_head(list)), TypeName##_flatmap(TypeName##_tail(list), func)); \
+    TypeName##List* result = empty_##TypeName##List; \
+    while (count > 0) { \
+        result = TypeName##_concat(parts[--count], result); \
+    } \
+    free(parts); \
+    return result; \
 } \
 \
 /* Find first element matching predicate */ \
 typedef bool (*TypeName##PredicateFunc)(Type, void*); \
 \
 bool TypeName##_find(TypeName##List* list, TypeName##PredicateFunc pred, void* ctx, Type* result) { \
-    if (TypeName##_is_empty(list)) { \
-        return false; \
+    for (; list; list = list->rest) { \
+        LIST_PREFETCH(list->rest); \
+        if (pred(list->head, ctx)) { \
+            *result = list->head; \
+            return true; \
+        } \
     } \
-    if (pred(TypeName##_head(list), ctx)) { \
-        *result = TypeName##_head(list); \
-        return true; \
-    } \
-    return TypeName##_find(TypeName##_tail(list), pred, ctx, result); \
+    return false; \
 } \
 \
 /* Check if any element satisfies predicate */ \
 bool TypeName##_any(TypeName##List* list, TypeName##PredicateFunc pred, void* ctx) { \
-    if (TypeName##_is_empty(list)) { \
-        return false; \
-    } \
-    if (pred(TypeName##_head(list), ctx)) { \
-        return true; \
+    for (; list; list = list->rest) { \
+        LIST_PREFETCH(list->rest); \
+        if (pred(list->head, ctx)) { \
+            return true; \
+        } \
     } \
-    return TypeName##_any(TypeName##_tail(list), pred, ctx); \
+    return false; \
 } \
 \
 /* Check if all elements satisfy predicate */ \
 bool TypeName##_all(TypeName##List* list, TypeName##PredicateFunc pred, void* ctx) { \
-    if (TypeName##_is_empty(list)) { \
-        return true; \
+    for (; list; list = list->rest) { \
+        LIST_PREFETCH(list->rest); \
+        if (!pred(list->head, ctx)) { \
+            return false; \
+        } \
     } \
-    if (!pred(TypeName##_head(list), ctx)) { \
-        return false; \
-    } \
-    return TypeName##_all(TypeName##_tail(list), pred, ctx); \
+    return true; \
 } \
 \
 /* For a proper zipWith that returns Type, the function should take (Type, Type) -> Type */ \
@@ -295,14 +712,17 @@ TypeName##List* TypeName##_zipWith(TypeName##List* list1, TypeName##List* list2,
 \
 /* Get element at index (0-based) */ \
 bool TypeName##_nth(TypeName##List* list, int index, Type* result) { \
-    if (TypeName##_is_empty(list) || index < 0) { \
+    if (index < 0) { \
         return false; \
     } \
-    if (index == 0) { \
-        *result = TypeName##_head(list); \
-        return true; \
+    for (; list && index > 0; index--) { \
+        list = list->rest; \
+    } \
+    if (TypeName##_is_empty(list)) { \
+        return false; \
     } \
-    return TypeName##_nth(TypeName##_tail(list), index - 1, result); \
+    *result = list->head; \
+    return true; \
 } \
 \
 /* Partition list into two based on predicate */ \
@@ -341,6 +761,179 @@ TypeName##List* TypeName##_dropWhile(TypeName##List* list, TypeName##PredicateFu
         return TypeName##_dropWhile(TypeName##_tail(list), pred, ctx); \
     } \
     return list; \
+} \
+\
+/* Lists restored from a checkpoint, plus the memory that backs them */ \
+typedef struct { \
+    TypeName##List** roots; \
+    size_t root_count; \
+    TypeName##List* nodes; \
+    size_t node_count; \
+    void* mapping;      /* non-NULL when restored with mmap */ \
+    size_t mapping_size; \
+} TypeName##Snapshot; \
+\
+/* Write every distinct node reachable from roots once, tail first */ \
+bool TypeName##_checkpoint(const char* path, TypeName##List** roots, size_t root_count) { \
+    ListPtrMap index; \
+    list_ptrmap_init(&index, 1024); \
+    size_t capacity = 1024, count = 0; \
+    TypeName##List** order = (TypeName##List**) list_alloc(capacity * sizeof(*order)); \
+    for (size_t r = 0; r < root_count; r++) { \
+        size_t start = count; \
+        for (TypeName##List* node = roots[r]; node && !list_ptrmap_get(&index, node, NULL); node = node->rest) { \
+            if (count == capacity) { \
+                order = (TypeName##List**) list_grow(order, &capacity, sizeof(*order)); \
+            } \
+            order[count++] = node; \
+        } \
+        for (size_t i = start, j = count; i + 1 < j; i++, j--) { \
+            TypeName##List* tmp = order[i]; \
+            order[i] = order[j - 1]; \
+            order[j - 1] = tmp; \
+        } \
+        for (size_t i = start; i < count; i++) { \
+            list_ptrmap_put(&index, order[i], i); \
+        } \
+    } \
+    /* Write beside the old checkpoint and swap it in only once the new one is on disk */ \
+    size_t path_len = strlen(path); \
+    char* tmp_path = (char*) list_alloc(path_len + 5); \
+    memcpy(tmp_path, path, path_len); \
+    memcpy(tmp_path + path_len, ".tmp", 5); \
+    FILE* out = fopen(tmp_path, "wb"); \
+    bool ok = out != NULL; \
+    if (ok) { \
+        ListCheckpointHeader header = { LIST_CHECKPOINT_MAGIC, sizeof(TypeName##List), count, root_count }; \
+        ok = fwrite(&header, sizeof(header), 1, out) == 1; \
+        for (size_t r = 0; ok && r < root_count; r++) { \
+            size_t i = 0; \
+            uint64_t slot = roots[r] && list_ptrmap_get(&index, roots[r], &i) ? (uint64_t)i + 1 : 0; \
+            ok = fwrite(&slot, sizeof(slot), 1, out) == 1; \
+        } \
+        static const char padding[64]; \
+        size_t pad = list_checkpoint_nodes_offset(root_count) - sizeof(header) - root_count * sizeof(uint64_t); \
+        ok = ok && fwrite(padding, 1, pad, out) == pad; \
+        for (size_t i = 0; ok && i < count; i++) { \
+            TypeName##List record; \
+            memset(&record, 0, sizeof(record)); \
+            record.head = order[i]->head; \
+            size_t j = i; \
+            if (order[i]->rest) list_ptrmap_get(&index, order[i]->rest, &j); \
+            record.rest = (TypeName##List*)(uintptr_t)(i - j); \
+            ok = fwrite(&record, sizeof(record), 1, out) == 1; \
+        } \
+        ok = ok && fflush(out) == 0 && fsync(fileno(out)) == 0; \
+        ok = fclose(out) == 0 && ok; \
+        ok = ok && rename(tmp_path, path) == 0; \
+        if (!ok) { \
+            unlink(tmp_path); \
+        } \
+    } \
+    free(tmp_path); \
+    free(order); \
+    list_ptrmap_free(&index); \
+    return ok; \
+} \
+\
+/* Turn relative rest distances back into pointers and resolve the roots */ \
+bool TypeName##_checkpoint_link(TypeName##Snapshot* snapshot, const uint64_t* root_index) { \
+    TypeName##List* nodes = snapshot->nodes; \
+    for (size_t i = 0; i < snapshot->node_count; i++) { \
+        uintptr_t distance = (uintptr_t) nodes[i].rest; \
+        if (distance > i) { \
+            return false; \
+        } \
+        nodes[i].rest = distance ? &nodes[i - distance] : empty_##TypeName##List; \
+    } \
+    for (size_t r = 0; r < snapshot->root_count; r++) { \
+        if (root_index[r] > snapshot->node_count) { \
+            return false; \
+        } \
+        snapshot->roots[r] = root_index[r] ? &nodes[root_index[r] - 1] : empty_##TypeName##List; \
+    } \
+    return true; \
+} \
+\
+/* Free the memory behind restored lists; they must not be used afterwards */ \
+void TypeName##_snapshot_release(TypeName##Snapshot* snapshot) { \
+    if (snapshot->mapping) { \
+        munmap(snapshot->mapping, snapshot->mapping_size); \
+    } else { \
+        free(snapshot->nodes); \
+    } \
+    free(snapshot->roots); \
+    snapshot->roots = NULL; \
+    snapshot->nodes = NULL; \
+    snapshot->mapping = NULL; \
+    snapshot->root_count = snapshot->node_count = snapshot->mapping_size = 0; \
+} \
+\
+/* Restore a checkpoint by reading its node table into one allocation */ \
+bool TypeName##_restore(const char* path, TypeName##Snapshot* snapshot) { \
+    FILE* in = fopen(path, "rb"); \
+    if (!in) { \
+        return false; \
+    } \
+    ListCheckpointHeader header; \
+    struct stat st; \
+    if (fstat(fileno(in), &st) != 0 || (size_t) st.st_size < sizeof(header) \
+        || fread(&header, sizeof(header), 1, in) != 1 \
+        || !list_checkpoint_valid(&header, sizeof(TypeName##List), (size_t) st.st_size)) { \
+        fclose(in); \
+        return false; \
+    } \
+    uint64_t* root_index = (uint64_t*) list_alloc(header.root_count * sizeof(uint64_t)); \
+    snapshot->root_count = header.root_count; \
+    snapshot->roots = (TypeName##List**) list_alloc(header.root_count * sizeof(TypeName##List*)); \
+    snapshot->node_count = header.node_count; \
+    snapshot->nodes = (TypeName##List*) list_alloc(header.node_count * sizeof(TypeName##List)); \
+    snapshot->mapping = NULL; \
+    snapshot->mapping_size = 0; \
+    bool ok = fread(root_index, sizeof(uint64_t), header.root_count, in) == header.root_count \
+        && fseek(in, (long) list_checkpoint_nodes_offset(header.root_count), SEEK_SET) == 0 \
+        && fread(snapshot->nodes, sizeof(TypeName##List), header.node_count, in) == header.node_count \
+        && TypeName##_checkpoint_link(snapshot, root_index); \
+    fclose(in); \
+    free(root_index); \
+    if (!ok) { \
+        TypeName##_snapshot_release(snapshot); \
+    } \
+    return ok; \
+} \
+\
+/* Restore a checkpoint by mapping the file privately and linking nodes in place */ \
+bool TypeName##_restore_mmap(const char* path, TypeName##Snapshot* snapshot) { \
+    int fd = open(path, O_RDONLY); \
+    if (fd < 0) { \
+        return false; \
+    } \
+    struct stat st; \
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ListCheckpointHeader)) { \
+        close(fd); \
+        return false; \
+    } \
+    void* mapping = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0); \
+    close(fd); \
+    if (mapping == MAP_FAILED) { \
+        return false; \
+    } \
+    const ListCheckpointHeader* header = (const ListCheckpointHeader*) mapping; \
+    if (!list_checkpoint_valid(header, sizeof(TypeName##List), (size_t) st.st_size)) { \
+        munmap(mapping, (size_t) st.st_size); \
+        return false; \
+    } \
+    snapshot->root_count = header->root_count; \
+    snapshot->roots = (TypeName##List**) list_alloc(header->root_count * sizeof(TypeName##List*)); \
+    snapshot->node_count = header->node_count; \
+    snapshot->nodes = (TypeName##List*) ((char*) mapping + list_checkpoint_nodes_offset(header->root_count)); \
+    snapshot->mapping = mapping; \
+    snapshot->mapping_size = (size_t) st.st_size; \
+    if (!TypeName##_checkpoint_link(snapshot, (const uint64_t*) (header + 1))) { \
+        TypeName##_snapshot_release(snapshot); \
+        return false; \
+    } \
+    return true; \
 }
 
 #endif // GENERIC_LIST_H
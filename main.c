@@ -1,31 +1,6 @@
 #include <stdbool.h>
 #include "order.c"
 
-Instruction times2(Instruction instruction)
-{
-    switch (instruction.type) {
-        case ORDER: instruction.order.price *= 2;
-        default:
-        return instruction;
-    }
-    return instruction;
-}
-
-bool has_id(Instruction instruction, void *ctx)
-{
-    int *id = (int*)ctx;
-    switch (instruction.type) {
-        case ORDER: return instruction.order.id == *id;
-        case CANCEL: return instruction.cancel.xid == *id;
-        case CANCEL_REPLACE: return instruction.cancel_replace.xr_id == *id;
-    }
-}
-
-InstructionList *filter_by_oid(InstructionList *instructions, int oid)
-{
-    return Instruction_filter(instructions, has_id, (void*)&oid);
-}
-
 int main()
 {
     InstructionList *il = 
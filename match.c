@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "order.c"
+
+/*
+ * PRICE-TIME PRIORITY MATCHING ENGINE
+ * ===================================
+ *
+ * match_process(engine, instruction) applies one Instruction to the book and
+ * returns the number of events it produced in engine->events:
+ *
+ *   ORDER           // Crosses against the opposite side, best price first and
+ *                   // oldest first within a price; any remainder rests
+ *   CANCEL          // Removes the resting order
+ *   CANCEL_REPLACE  // Shrinking at the same price keeps time priority and
+ *                   // the same price and size is a no-op with no events;
+ *                   // anything else cancels and re-enters as a new ORDER
+ *
+ * Each side is a dense ladder of level_count price levels starting at
+ * base_price, one tick apart, and every level is a FIFO of resting orders.
+ * Orders, levels, the id index and the event buffer are all allocated by
+ * match_engine_init, so processing instructions never touches the heap.
+ * Instructions that cannot be applied (unknown id, duplicate id, unknown
+ * side, price off the ladder, full pool) produce a MATCH_REJECT event
+ * instead; a rejected CANCEL_REPLACE leaves the original order resting.
+ */
+
+typedef enum {
+    MATCH_FILL,          // resting order completely filled
+    MATCH_PARTIAL_FILL,  // resting order partly filled, remaining stays in the book
+    MATCH_CANCEL_ACK,    // resting order removed by CANCEL or CANCEL_REPLACE
+    MATCH_REJECT,        // instruction could not be applied
+} MatchEventKind;
+
+typedef struct {
+    MatchEventKind kind;
+    int taker_id;
+    int maker_id;
+    float price;
+    int size;            // filled or cancelled quantity
+    int remaining;       // quantity the maker still has resting
+} MatchEvent;
+
+/* Resting order; prev and next link it into its level's FIFO */
+typedef struct {
+    int id;
+    int size;
+    int level;
+    Side side;
+    int prev;
+    int next;
+} MatchOrder;
+
+typedef struct {
+    int head;
+    int tail;
+} MatchLevel;
+
+typedef struct {
+    float base_price;
+    float tick_size;
+    int level_count;
+    MatchLevel *levels[2];   // indexed by Side
+    int best[2];             // best bid and best ask level, -1 when the side is empty
+    MatchOrder *orders;
+    int order_capacity;
+    int free_order;          // head of the free list, linked through next
+    int *index;              // id -> order slot, open addressing, -1 when empty
+    size_t index_mask;
+    MatchEvent *events;
+    int event_count;
+} MatchEngine;
+
+void match_engine_init(MatchEngine *engine, float base_price, float tick_size, int level_count, int order_capacity) {
+    engine->base_price = base_price;
+    engine->tick_size = tick_size;
+    engine->level_count = level_count;
+    for (int side = BUY; side <= SELL; side++) {
+        engine->levels[side] = (MatchLevel*) list_alloc(level_count * sizeof(MatchLevel));
+        for (int i = 0; i < level_count; i++) {
+            engine->levels[side][i] = (MatchLevel){ -1, -1 };
+        }
+        engine->best[side] = -1;
+    }
+    engine->order_capacity = order_capacity;
+    engine->orders = (MatchOrder*) list_alloc(order_capacity * sizeof(MatchOrder));
+    for (int i = 0; i < order_capacity; i++) {
+        engine->orders[i].next = i + 1 < order_capacity ? i + 1 : -1;
+    }
+    engine->free_order = order_capacity > 0 ? 0 : -1;
+    size_t index_capacity = 16;
+    while (index_capacity < (size_t) order_capacity * 2) index_capacity *= 2;
+    engine->index = (int*) list_alloc(index_capacity * sizeof(int));
+    memset(engine->index, -1, index_capacity * sizeof(int));
+    engine->index_mask = index_capacity - 1;
+    // An ORDER fills at most every resting order, plus one event of its own
+    engine->events = (MatchEvent*) list_alloc((order_capacity + 2) * sizeof(MatchEvent));
+    engine->event_count = 0;
+}
+
+void match_engine_free(MatchEngine *engine) {
+    free(engine->levels[BUY]);
+    free(engine->levels[SELL]);
+    free(engine->orders);
+    free(engine->index);
+    free(engine->events);
+}
+
+static size_t match_hash(int id) {
+    uint32_t x = (uint32_t) id;
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    return x;
+}
+
+/* Slot of the resting order with this id, or -1 */
+static int match_lookup(MatchEngine *engine, int id) {
+    for (size_t i = match_hash(id) & engine->index_mask; engine->index[i] >= 0; i = (i + 1) & engine->index_mask) {
+        if (engine->orders[engine->index[i]].id == id) {
+            return engine->index[i];
+        }
+    }
+    return -1;
+}
+
+static void match_index_insert(MatchEngine *engine, int slot) {
+    size_t i = match_hash(engine->orders[slot].id) & engine->index_mask;
+    while (engine->index[i] >= 0) i = (i + 1) & engine->index_mask;
+    engine->index[i] = slot;
+}
+
+/* Remove from the index, shifting later probes back so lookups stay correct */
+static void match_index_remove(MatchEngine *engine, int id) {
+    size_t mask = engine->index_mask;
+    size_t i = match_hash(id) & mask;
+    while (engine->orders[engine->index[i]].id != id) i = (i + 1) & mask;
+    for (size_t j = (i + 1) & mask; engine->index[j] >= 0; j = (j + 1) & mask) {
+        size_t home = match_hash(engine->orders[engine->index[j]].id) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            engine->index[i] = engine->index[j];
+            i = j;
+        }
+    }
+    engine->index[i] = -1;
+}
+
+static void match_emit(MatchEngine *engine, MatchEventKind kind, int taker_id, int maker_id, float price, int size, int remaining) {
+    engine->events[engine->event_count++] = (MatchEvent){ kind, taker_id, maker_id, price, size, remaining };
+}
+
+static float match_level_price(MatchEngine *engine, int level) {
+    return engine->base_price + level * engine->tick_size;
+}
+
+/* Ladder level for a price, or -1 when it is off the ladder */
+static int match_level_of(MatchEngine *engine, float price) {
+    long level = lroundf((price - engine->base_price) / engine->tick_size);
+    return level >= 0 && level < engine->level_count ? (int) level : -1;
+}
+
+/* Move best[side] to the next non-empty level after level was emptied */
+static void match_refresh_best(MatchEngine *engine, Side side) {
+    MatchLevel *levels = engine->levels[side];
+    int level = engine->best[side];
+    int step = side == BUY ? -1 : 1;
+    while (level >= 0 && level < engine->level_count && levels[level].head < 0) {
+        level += step;
+    }
+    engine->best[side] = level >= 0 && level < engine->level_count ? level : -1;
+}
+
+static void match_unlink(MatchEngine *engine, int slot) {
+    MatchOrder *order = &engine->orders[slot];
+    MatchLevel *level = &engine->levels[order->side][order->level];
+    if (order->prev >= 0) engine->orders[order->prev].next = order->next;
+    else level->head = order->next;
+    if (order->next >= 0) engine->orders[order->next].prev = order->prev;
+    else level->tail = order->prev;
+    match_index_remove(engine, order->id);
+    order->next = engine->free_order;
+    engine->free_order = slot;
+    if (level->head < 0 && engine->best[order->side] == order->level) {
+        match_refresh_best(engine, order->side);
+    }
+}
+
+static void match_rest(MatchEngine *engine, Order order, int level) {
+    int slot = engine->free_order;
+    engine->free_order = engine->orders[slot].next;
+    MatchLevel *ladder = &engine->levels[order.side][level];
+    engine->orders[slot] = (MatchOrder){ order.id, order.size, level, order.side, ladder->tail, -1 };
+    if (ladder->tail >= 0) engine->orders[ladder->tail].next = slot;
+    else ladder->head = slot;
+    ladder->tail = slot;
+    match_index_insert(engine, slot);
+    int best = engine->best[order.side];
+    if (best < 0 || (order.side == BUY ? level > best : level < best)) {
+        engine->best[order.side] = level;
+    }
+}
+
+static void match_order(MatchEngine *engine, Order order) {
+    int level = match_level_of(engine, order.price);
+    if (level < 0 || order.size <= 0 || (order.side != BUY && order.side != SELL) || match_lookup(engine, order.id) >= 0) {
+        match_emit(engine, MATCH_REJECT, order.id, -1, order.price, order.size, 0);
+        return;
+    }
+    Side opposite = order.side == BUY ? SELL : BUY;
+    while (order.size > 0) {
+        int best = engine->best[opposite];
+        if (best < 0 || (order.side == BUY ? best > level : best < level)) {
+            break;
+        }
+        int slot = engine->levels[opposite][best].head;
+        MatchOrder *maker = &engine->orders[slot];
+        int size = maker->size < order.size ? maker->size : order.size;
+        maker->size -= size;
+        order.size -= size;
+        float price = match_level_price(engine, best);
+        if (maker->size == 0) {
+            match_emit(engine, MATCH_FILL, order.id, maker->id, price, size, 0);
+            match_unlink(engine, slot);
+        } else {
+            match_emit(engine, MATCH_PARTIAL_FILL, order.id, maker->id, price, size, maker->size);
+        }
+    }
+    if (order.size > 0) {
+        if (engine->free_order < 0) {
+            match_emit(engine, MATCH_REJECT, order.id, -1, order.price, order.size, 0);
+            return;
+        }
+        match_rest(engine, order, level);
+    }
+}
+
+static void match_cancel(MatchEngine *engine, int id) {
+    int slot = match_lookup(engine, id);
+    if (slot < 0) {
+        match_emit(engine, MATCH_REJECT, id, -1, 0, 0, 0);
+        return;
+    }
+    MatchOrder *order = &engine->orders[slot];
+    match_emit(engine, MATCH_CANCEL_ACK, -1, id, match_level_price(engine, order->level), order->size, 0);
+    match_unlink(engine, slot);
+}
+
+static void match_cancel_replace(MatchEngine *engine, CancelReplace replace) {
+    int slot = match_lookup(engine, replace.xr_id);
+    if (slot < 0) {
+        match_emit(engine, MATCH_REJECT, replace.xr_id, -1, replace.new_price, replace.new_size, 0);
+        return;
+    }
+    MatchOrder *order = &engine->orders[slot];
+    int level = match_level_of(engine, replace.new_price);
+    if (level < 0 || replace.new_size <= 0) {
+        // Leave the resting order alone rather than cancel it for an invalid replacement
+        match_emit(engine, MATCH_REJECT, replace.xr_id, -1, replace.new_price, replace.new_size, 0);
+        return;
+    }
+    if (level == order->level && replace.new_size == order->size) {
+        return;   // nothing changes, so no zero-quantity ack either
+    }
+    if (level == order->level && replace.new_size < order->size) {
+        match_emit(engine, MATCH_CANCEL_ACK, -1, order->id, match_level_price(engine, level), order->size - replace.new_size, replace.new_size);
+        order->size = replace.new_size;
+        return;
+    }
+    Side side = order->side;
+    match_cancel(engine, replace.xr_id);
+    match_order(engine, (Order){ .id = replace.xr_id, .price = replace.new_price, .size = replace.new_size, .side = side });
+}
+
+/* Apply one instruction; the events it produced are in engine->events */
+int match_process(MatchEngine *engine, Instruction instruction) {
+    engine->event_count = 0;
+    switch (instruction.type) {
+        case ORDER: match_order(engine, instruction.order); break;
+        case CANCEL: match_cancel(engine, instruction.cancel.xid); break;
+        case CANCEL_REPLACE: match_cancel_replace(engine, instruction.cancel_replace); break;
+    }
+    return engine->event_count;
+}
@@ -1,14 +1,24 @@
+#ifndef ORDER_C
+#define ORDER_C
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
 
 #include "list.h"
+#include "queue.h"
+
+typedef enum {
+    BUY,
+    SELL,
+} Side;
 
 typedef struct {
     int id;
     float price;
     int size;
+    Side side;
 } Order;
 
 typedef struct {
@@ -37,6 +47,7 @@ typedef struct {
 } Instruction;
 
 DEFINE_LIST(Instruction, Instruction);
+DEFINE_QUEUE(Instruction, Instruction);
 
 // // Immutable list
 // typedef struct InstructionList {
@@ -167,3 +178,29 @@ void print_list(char *name, InstructionList* list) {
     printf("]\n");
 }
 
+Instruction times2(Instruction instruction)
+{
+    switch (instruction.type) {
+        case ORDER: instruction.order.price *= 2;
+        default:
+        return instruction;
+    }
+    return instruction;
+}
+
+bool has_id(Instruction instruction, void *ctx)
+{
+    int *id = (int*)ctx;
+    switch (instruction.type) {
+        case ORDER: return instruction.order.id == *id;
+        case CANCEL: return instruction.cancel.xid == *id;
+        case CANCEL_REPLACE: return instruction.cancel_replace.xr_id == *id;
+    }
+}
+
+InstructionList *filter_by_oid(InstructionList *instructions, int oid)
+{
+    return Instruction_filter(instructions, has_id, (void*)&oid);
+}
+
+#endif // ORDER_C
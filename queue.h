@@ -0,0 +1,176 @@
+#ifndef GENERIC_QUEUE_H
+#define GENERIC_QUEUE_H
+
+#include "list.h"
+
+/*
+ * GENERIC IMMUTABLE QUEUE LIBRARY
+ * ================================
+ *
+ * Usage:
+ * ------
+ * DEFINE_QUEUE(Type, TypeName) generates a persistent FIFO queue. It needs
+ * DEFINE_LIST(Type, TypeName) to come first, since the rear of the queue is
+ * a TypeNameList.
+ *
+ * Example:
+ *   DEFINE_LIST(Instruction, Instruction)
+ *   DEFINE_QUEUE(Instruction, Instruction)  // Creates InstructionQueue, etc.
+ *
+ * This is Okasaki's real-time queue: a lazily rotated front stream, a rear
+ * list and a schedule that forces one front cell per operation, so snoc,
+ * head and tail are O(1) in the worst case, not just amortized. Old versions
+ * stay valid and share structure with new ones. Forcing memoizes into shared
+ * cells, so a queue must not be used from several threads at once.
+ *
+ * Generated Types:
+ * ----------------
+ * - TypeNameQueue                   // The queue (a small value, pass by copy)
+ * - TypeNameStream                  // Lazily rotated front stream cell
+ *
+ * Operations:
+ * -----------
+ * TypeName_queue_empty()            // The empty queue
+ * TypeName_queue_is_empty(queue)    // Check if empty
+ * TypeName_queue_length(queue)      // Number of elements, O(1)
+ * TypeName_queue_snoc(queue, value) // Push at the back
+ * TypeName_queue_head(queue)        // Get front element
+ * TypeName_queue_tail(queue)        // Pop the front element
+ * TypeName_queue_to_list(queue)     // Elements front to back as a list
+ *
+ */
+
+// Macro to define a generic persistent queue type and its operations
+#define DEFINE_QUEUE(Type, TypeName) \
+\
+/* Front stream cell; holds a pending rotate(front, rear, acc) until forced */ \
+typedef struct TypeName##Stream { \
+    bool forced; \
+    Type head; \
+    struct TypeName##Stream* rest; \
+    struct TypeName##Stream* front; \
+    TypeName##List* rear; \
+    struct TypeName##Stream* acc; \
+} TypeName##Stream; \
+\
+/* Queue structure */ \
+typedef struct { \
+    TypeName##Stream* front; \
+    TypeName##List* rear; \
+    TypeName##Stream* schedule; \
+    size_t length; \
+} TypeName##Queue; \
+\
+/* An evaluated stream cell */ \
+TypeName##Stream* TypeName##_stream_cons(Type head, TypeName##Stream* rest) { \
+    TypeName##Stream* cell = (TypeName##Stream*) list_alloc(sizeof(TypeName##Stream)); \
+    cell->forced = true; \
+    cell->head = head; \
+    cell->rest = rest; \
+    cell->front = NULL; \
+    cell->rear = NULL; \
+    cell->acc = NULL; \
+    return cell; \
+} \
+\
+/* A suspended rotate: front ++ reverse(rear) ++ acc, with |rear| = |front| + 1 */ \
+TypeName##Stream* TypeName##_stream_rotate(TypeName##Stream* front, TypeName##List* rear, TypeName##Stream* acc) { \
+    TypeName##Stream* cell = (TypeName##Stream*) list_alloc(sizeof(TypeName##Stream)); \
+    cell->forced = false; \
+    cell->rest = NULL; \
+    cell->front = front; \
+    cell->rear = rear; \
+    cell->acc = acc; \
+    return cell; \
+} \
+\
+/* Evaluate one step of a suspended rotate and memoize it */ \
+TypeName##Stream* TypeName##_stream_force(TypeName##Stream* cell) { \
+    if (cell->forced) { \
+        return cell; \
+    } \
+    if (!cell->front) { \
+        cell->head = cell->rear->head; \
+        cell->rest = cell->acc; \
+    } else { \
+        TypeName##Stream* front = TypeName##_stream_force(cell->front); \
+        cell->head = front->head; \
+        cell->rest = TypeName##_stream_rotate(front->rest, cell->rear->rest, \
+            TypeName##_stream_cons(cell->rear->head, cell->acc)); \
+    } \
+    cell->forced = true; \
+    cell->front = NULL; \
+    cell->rear = NULL; \
+    cell->acc = NULL; \
+    return cell; \
+} \
+\
+/* The empty queue */ \
+TypeName##Queue TypeName##_queue_empty(void) { \
+    TypeName##Queue queue = { NULL, empty_##TypeName##List, NULL, 0 }; \
+    return queue; \
+} \
+\
+/* Check if queue is empty */ \
+bool TypeName##_queue_is_empty(TypeName##Queue queue) { \
+    return queue.front == NULL; \
+} \
+\
+/* Number of elements in the queue */ \
+size_t TypeName##_queue_length(TypeName##Queue queue) { \
+    return queue.length; \
+} \
+\
+/* Force one scheduled cell, or start a new rotation once the schedule runs out */ \
+TypeName##Queue TypeName##_queue_exec(TypeName##Stream* front, TypeName##List* rear, TypeName##Stream* schedule, size_t length) { \
+    TypeName##Queue queue = { front, rear, NULL, length }; \
+    if (schedule) { \
+        queue.schedule = TypeName##_stream_force(schedule)->rest; \
+        return queue; \
+    } \
+    queue.front = TypeName##_stream_rotate(front, rear, NULL); \
+    queue.rear = empty_##TypeName##List; \
+    queue.schedule = queue.front; \
+    return queue; \
+} \
+\
+/* Push an element at the back (returns new queue) */ \
+TypeName##Queue TypeName##_queue_snoc(TypeName##Queue queue, Type value) { \
+    return TypeName##_queue_exec(queue.front, TypeName##_cons(value, queue.rear), queue.schedule, queue.length + 1); \
+} \
+\
+/* Get the front element of the queue */ \
+Type TypeName##_queue_head(TypeName##Queue queue) { \
+    if (TypeName##_queue_is_empty(queue)) { \
+        fprintf(stderr, "head of empty queue\n"); \
+        exit(1); \
+    } \
+    return TypeName##_stream_force(queue.front)->head; \
+} \
+\
+/* Pop the front element (returns new queue) */ \
+TypeName##Queue TypeName##_queue_tail(TypeName##Queue queue) { \
+    if (TypeName##_queue_is_empty(queue)) { \
+        fprintf(stderr, "tail of empty queue\n"); \
+        exit(1); \
+    } \
+    TypeName##Stream* front = TypeName##_stream_force(queue.front)->rest; \
+    return TypeName##_queue_exec(front, queue.rear, queue.schedule, queue.length - 1); \
+} \
+\
+/* Elements front to back as a list */ \
+TypeName##List* TypeName##_queue_to_list(TypeName##Queue queue) { \
+    TypeName##List* list = TypeName##_reverse(queue.rear); \
+    size_t count = 0; \
+    Type* front = (Type*) list_alloc(queue.length * sizeof(Type)); \
+    for (TypeName##Stream* cell = queue.front; cell; cell = TypeName##_stream_force(cell)->rest) { \
+        front[count++] = TypeName##_stream_force(cell)->head; \
+    } \
+    while (count > 0) { \
+        list = TypeName##_cons(front[--count], list); \
+    } \
+    free(front); \
+    return list; \
+}
+
+#endif // GENERIC_QUEUE_H
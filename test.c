@@ -0,0 +1,453 @@
+/*
+ * Tests
+ * =====
+ *
+ * Build and run:
+ *   cc -pthread -o test test.c -lm && ./test
+ *
+ * Prints each failed check and exits non-zero if any failed.
+ */
+#include <stddef.h>
+
+#include "ingest.c"
+#include "match.c"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+#define ORD(i) ((Instruction){.type = ORDER, .order = {.id = (i), .price = (float)(i)}})
+
+static InstructionList *range(int n)
+{
+    InstructionList *list = empty_InstructionList;
+    for (int i = n; i > 0; i--) {
+        list = Instruction_cons(ORD(i), list);
+    }
+    return list;
+}
+
+static void write_file(const char *path, const void *data, size_t size)
+{
+    FILE *out = fopen(path, "wb");
+    fwrite(data, 1, size, out);
+    fclose(out);
+}
+
+static void test_checkpoint(void)
+{
+    const char *path = "/tmp/taggedunion_test.ck";
+    InstructionList *base = range(1000);
+    InstructionList *dropped = Instruction_drop(base, 10);
+    InstructionList *joined = Instruction_concat(Instruction_take(base, 3), dropped);
+    InstructionList *roots[] = { base, dropped, joined, empty_InstructionList };
+    CHECK(Instruction_checkpoint(path, roots, 4));
+    CHECK(access("/tmp/taggedunion_test.ck.tmp", F_OK) != 0);
+
+    for (int mapped = 0; mapped < 2; mapped++) {
+        InstructionSnapshot snapshot;
+        bool ok = mapped ? Instruction_restore_mmap(path, &snapshot) : Instruction_restore(path, &snapshot);
+        CHECK(ok);
+        if (!ok) continue;
+        CHECK(snapshot.node_count == 1003);
+        CHECK(Instruction_equal(snapshot.roots[0], base));
+        CHECK(Instruction_equal(snapshot.roots[2], joined));
+        CHECK(Instruction_drop(snapshot.roots[0], 10) == snapshot.roots[1]);
+        CHECK(Instruction_drop(snapshot.roots[2], 3) == snapshot.roots[1]);
+        CHECK(snapshot.roots[3] == empty_InstructionList);
+        Instruction_snapshot_release(&snapshot);
+    }
+
+    // A failed write leaves the previous checkpoint in place
+    mkdir("/tmp/taggedunion_test.ck.tmp", 0700);
+    CHECK(!Instruction_checkpoint(path, &dropped, 1));
+    rmdir("/tmp/taggedunion_test.ck.tmp");
+    InstructionSnapshot previous;
+    CHECK(Instruction_restore(path, &previous) && previous.root_count == 4);
+    Instruction_snapshot_release(&previous);
+
+    // Corrupt files are rejected, not trusted
+    ListCheckpointHeader header = { LIST_CHECKPOINT_MAGIC, sizeof(InstructionList), 1ULL << 50, 0 };
+    const char *bad = "/tmp/taggedunion_test_bad.ck";
+    char block[128] = {0};
+    memcpy(block, &header, sizeof(header));
+    InstructionSnapshot snapshot;
+    write_file(bad, block, sizeof(block));
+    CHECK(!Instruction_restore(bad, &snapshot));
+    CHECK(!Instruction_restore_mmap(bad, &snapshot));
+
+    header.node_count = 0;
+    header.root_count = 1ULL << 40;
+    memcpy(block, &header, sizeof(header));
+    write_file(bad, block, sizeof(block));
+    CHECK(!Instruction_restore(bad, &snapshot));
+    CHECK(!Instruction_restore_mmap(bad, &snapshot));
+
+    memcpy(block, "XXXX", 4);
+    write_file(bad, block, sizeof(block));
+    CHECK(!Instruction_restore(bad, &snapshot));
+    CHECK(!Instruction_restore_mmap(bad, &snapshot));
+
+    write_file(bad, block, 8);
+    CHECK(!Instruction_restore(bad, &snapshot));
+    CHECK(!Instruction_restore_mmap(bad, &snapshot));
+
+    // A rest distance pointing past the start of the node table
+    InstructionList *pair = range(2);
+    CHECK(Instruction_checkpoint(bad, &pair, 1));
+    FILE *patch = fopen(bad, "r+b");
+    uintptr_t distance = 5;
+    fseek(patch, (long)(list_checkpoint_nodes_offset(1) + offsetof(InstructionList, rest)), SEEK_SET);
+    fwrite(&distance, sizeof(distance), 1, patch);
+    fclose(patch);
+    CHECK(!Instruction_restore(bad, &snapshot));
+    CHECK(!Instruction_restore_mmap(bad, &snapshot));
+    unlink(bad);
+    unlink(path);
+}
+
+static bool is_even(Instruction instruction, void *ctx)
+{
+    (void)ctx;
+    return instruction.order.id % 2 == 0;
+}
+
+static void test_interning(void)
+{
+    Instruction_set_interning(true);
+    InstructionList *base = range(100);
+    size_t before = Instruction_interned.count;
+    InstructionList *a = Instruction_filter(Instruction_map(base, times2), is_even, NULL);
+    size_t after = Instruction_interned.count;
+    InstructionList *b = Instruction_filter(Instruction_map(base, times2), is_even, NULL);
+    CHECK(after > before);
+    CHECK(Instruction_interned.count == after);
+    CHECK(a == b);
+    CHECK(range(100) == base);
+    CHECK(Instruction_take(base, 100) == base);
+    Instruction_set_interning(false);
+
+    InstructionList *c = Instruction_filter(Instruction_map(base, times2), is_even, NULL);
+    CHECK(c != a);
+    CHECK(Instruction_equal(c, a));
+    CHECK(!Instruction_equal(c, Instruction_tail(a)));
+    Instruction_intern_clear();
+    CHECK(Instruction_interned.count == 0);
+    CHECK(Instruction_length(a) == 50);
+}
+
+static InstructionList *expand(Instruction instruction)
+{
+    if (instruction.type != CANCEL_REPLACE) {
+        return Instruction_cons(instruction, empty_InstructionList);
+    }
+    int id = instruction.cancel_replace.xr_id;
+    return Instruction_cons((Instruction){.type = CANCEL, .cancel = {.xid = id}},
+        Instruction_cons((Instruction){.type = ORDER, .order = {.id = id, .price = instruction.cancel_replace.new_price}},
+        empty_InstructionList));
+}
+
+static void test_seq(void)
+{
+    InstructionSeq *seq = empty_InstructionSeq;
+    for (int k = 0; k < 4; k++) {
+        seq = Instruction_seq_concat(seq, Instruction_seq_of(range(3)));
+    }
+    seq = Instruction_seq_concat(Instruction_seq_of(range(2)), seq);
+    int expected[] = { 1, 2, 1, 2, 3, 1, 2, 3, 1, 2, 3, 1, 2, 3 };
+    InstructionSeq *rest = seq;
+    Instruction head;
+    int n = 0;
+    while (Instruction_seq_uncons(rest, &head, &rest)) {
+        CHECK(n < 14 && head.order.id == expected[n]);
+        n++;
+    }
+    CHECK(n == 14);
+    InstructionList *flat = Instruction_seq_to_list(seq);
+    CHECK(Instruction_length(flat) == 14);
+    CHECK(Instruction_equal(Instruction_drop(flat, 11), range(3)));
+    InstructionList *last = range(3);
+    InstructionList *joined = Instruction_seq_to_list(Instruction_seq_concat(Instruction_seq_of(range(2)), Instruction_seq_of(last)));
+    CHECK(Instruction_drop(joined, 2) == last);
+    CHECK(Instruction_seq_to_list(empty_InstructionSeq) == empty_InstructionList);
+
+    InstructionList *input = Instruction_cons(ORD(1),
+        Instruction_cons((Instruction){.type = CANCEL_REPLACE, .cancel_replace = {.xr_id = 1, .new_price = 2}},
+        Instruction_cons(ORD(3), empty_InstructionList)));
+    InstructionList *expanded = Instruction_flatmap(input, expand);
+    CHECK(Instruction_length(expanded) == 4);
+    Instruction second;
+    CHECK(Instruction_nth(expanded, 1, &second) && second.type == CANCEL && second.cancel.xid == 1);
+    CHECK(Instruction_flatmap(empty_InstructionList, expand) == empty_InstructionList);
+}
+
+static void test_queue(void)
+{
+    InstructionQueue queue = Instruction_queue_empty();
+    InstructionQueue versions[8];
+    int model[5000];
+    int front = 0, back = 0, saved = 0;
+    srand(7);
+    for (int step = 0; step < 5000; step++) {
+        if (rand() % 3 || Instruction_queue_is_empty(queue)) {
+            queue = Instruction_queue_snoc(queue, ORD(back + 1));
+            model[back] = back + 1;
+            back++;
+        } else {
+            CHECK(Instruction_queue_head(queue).order.id == model[front]);
+            queue = Instruction_queue_tail(queue);
+            front++;
+        }
+        CHECK(Instruction_queue_length(queue) == (size_t)(back - front));
+        if (step % 700 == 0 && saved < 8) versions[saved++] = queue;
+    }
+
+    // Older versions still hold their own contents in FIFO order
+    for (int v = 0; v < saved; v++) {
+        InstructionQueue old = versions[v];
+        InstructionList *list = Instruction_queue_to_list(old);
+        CHECK(Instruction_length(list) == (int)Instruction_queue_length(old));
+        int previous = 0;
+        while (!Instruction_queue_is_empty(old)) {
+            Instruction head = Instruction_queue_head(old);
+            CHECK(head.order.id == previous + 1 || previous == 0);
+            CHECK(list && list->head.order.id == head.order.id);
+            previous = head.order.id;
+            list = list ? list->rest : list;
+            old = Instruction_queue_tail(old);
+        }
+        CHECK(list == empty_InstructionList);
+    }
+}
+
+typedef struct {
+    size_t count;
+    int last_id;
+    Side last_side;
+} IngestTotals;
+
+static void count_batch(InstructionList *batch, size_t count, void *ctx)
+{
+    IngestTotals *totals = (IngestTotals*)ctx;
+    CHECK(Instruction_length(batch) == (int)count);
+    for (InstructionList *node = batch; node; node = node->rest) {
+        totals->count++;
+        totals->last_id = instruction_id(node->head);
+        totals->last_side = node->head.order.side;
+    }
+    free(batch);
+}
+
+static bool ingest_text(const char *text, IngestTotals *totals)
+{
+    const char *path = "/tmp/taggedunion_test.txt";
+    write_file(path, text, strlen(text));
+    *totals = (IngestTotals){0};
+    bool ok = ingest_file(path, INGEST_TEXT, count_batch, totals);
+    unlink(path);
+    return ok;
+}
+
+static void test_ingest_text(void)
+{
+    IngestTotals totals;
+    CHECK(ingest_text("ORDER 1 10.5 3\n\nCANCEL 1\r\nCANCEL_REPLACE 2 11 4\nORDER 5 9.25 2 SELL", &totals));
+    CHECK(totals.count == 4 && totals.last_id == 5 && totals.last_side == SELL);
+    CHECK(ingest_text("  ORDER 7 1 1 BUY  \n", &totals) && totals.count == 1 && totals.last_side == BUY);
+
+    const char *malformed[] = {
+        "ORDER\n",
+        "ORDER 5\n",
+        "CANCELLED 7\n",
+        "ORDERS 1 2 3\n",
+        "ORDER 5 abc 3\n",
+        "ORDER 5 1.5 3 SELLX\n",
+        "ORDER 5 1.5 3 SELL extra\n",
+        "ORDER 51.5 3\n",
+        "ORDER 5 1.5x 3\n",
+        "CANCEL 99999999999\n",
+        "CANCEL_REPLACE 1 2\n",
+        "FOO 1\n",
+    };
+    for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        if (ingest_text(malformed[i], &totals)) {
+            fprintf(stderr, "accepted malformed line: %s", malformed[i]);
+            failures++;
+        }
+    }
+}
+
+static void test_ingest_binary(void)
+{
+    const char *path = "/tmp/taggedunion_test.bin";
+    IngestTotals totals = {0};
+    Instruction records[3] = { ORD(1), ORD(2), ORD(3) };
+    records[2].order.side = SELL;
+    CHECK(ingest_write_binary(path, Instruction_from_array(records, 3)));
+    CHECK(ingest_file(path, INGEST_BINARY, count_batch, &totals));
+    CHECK(totals.count == 3 && totals.last_id == 3 && totals.last_side == SELL);
+
+    // Headerless records, as written before the header existed
+    write_file(path, records, sizeof(records));
+    CHECK(!ingest_file(path, INGEST_BINARY, count_batch, &totals));
+
+    // Records of another layout
+    char block[8 + sizeof(records)];
+    IngestBinaryHeader header = { INGEST_BINARY_MAGIC, sizeof(Instruction) - 4 };
+    memcpy(block, &header, sizeof(header));
+    memcpy(block + sizeof(header), records, sizeof(records));
+    write_file(path, block, sizeof(block));
+    CHECK(!ingest_file(path, INGEST_BINARY, count_batch, &totals));
+
+    // Records with a side or type outside their enum
+    records[1].order.side = (Side) 9;
+    memcpy(block + sizeof(header), records, sizeof(records));
+    header.record_size = sizeof(Instruction);
+    memcpy(block, &header, sizeof(header));
+    write_file(path, block, sizeof(block));
+    CHECK(!ingest_file(path, INGEST_BINARY, count_batch, &totals));
+    records[1].order.side = BUY;
+    records[1].type = (Type) 7;
+    memcpy(block + sizeof(header), records, sizeof(records));
+    write_file(path, block, sizeof(block));
+    CHECK(!ingest_file(path, INGEST_BINARY, count_batch, &totals));
+    records[1].type = ORDER;
+    memcpy(block + sizeof(header), records, sizeof(records));
+
+    // Truncated last record, short header and empty file
+    header.record_size = sizeof(Instruction);
+    memcpy(block, &header, sizeof(header));
+    write_file(path, block, sizeof(block) - 1);
+    CHECK(!ingest_file(path, INGEST_BINARY, count_batch, &totals));
+    write_file(path, block, 5);
+    CHECK(!ingest_file(path, INGEST_BINARY, count_batch, &totals));
+    write_file(path, block, 0);
+    CHECK(!ingest_file(path, INGEST_BINARY, count_batch, &totals));
+    CHECK(!ingest_file("/tmp/no_such_file.bin", INGEST_BINARY, count_batch, &totals));
+    unlink(path);
+}
+
+/* The pread reader thread, used where io_uring cannot read, on a file spanning several buffers */
+static void test_ingest_thread(void)
+{
+    const char *path = "/tmp/taggedunion_test_large.txt";
+    FILE *out = fopen(path, "w");
+    int lines = 3 * INGEST_BUFFER_SIZE / 16;
+    for (int i = 1; i <= lines; i++) {
+        fprintf(out, "ORDER %d 1.5 %d\n", i, i % 100);
+    }
+    fclose(out);
+
+    IngestTotals ring = {0};
+    CHECK(ingest_file(path, INGEST_TEXT, count_batch, &ring));
+    CHECK(ring.count == (size_t)lines && ring.last_id == lines);
+
+    IngestTotals thread = {0};
+    int fd = open(path, O_RDONLY);
+    char *buffers = (char*) list_alloc((size_t) INGEST_BUFFERS * INGEST_BUFFER_SIZE);
+    IngestDecoder decoder = { .format = INGEST_TEXT, .func = count_batch, .ctx = &thread, .batch_capacity = 1024 };
+    decoder.batch = (Instruction*) list_alloc(decoder.batch_capacity * sizeof(Instruction));
+    CHECK(ingest_with_thread(fd, buffers, &decoder) && ingest_finish(&decoder));
+    CHECK(thread.count == (size_t)lines && thread.last_id == lines);
+    free(decoder.batch);
+    free(buffers);
+    close(fd);
+    unlink(path);
+}
+
+static void test_arrays(void)
+{
+    Instruction values[5] = { ORD(1), ORD(2), ORD(3), ORD(4), ORD(5) };
+    InstructionList *list = Instruction_from_array(values, 5);
+    CHECK(Instruction_equal(list, range(5)));
+    CHECK(&list[4] == Instruction_drop(list, 4));
+    CHECK(Instruction_from_array(values, 0) == empty_InstructionList);
+
+    size_t count;
+    Instruction *copy = Instruction_to_array(range(5), &count);
+    CHECK(count == 5 && copy[0].order.id == 1 && copy[4].order.id == 5);
+    free(copy);
+    copy = Instruction_to_array(empty_InstructionList, &count);
+    CHECK(count == 0);
+    free(copy);
+
+    // copy_to stops at the capacity and leaves the rest of out alone
+    Instruction out[4] = { ORD(9), ORD(9), ORD(9), ORD(9) };
+    CHECK(Instruction_copy_to(list, out, 3) == 3);
+    CHECK(out[0].order.id == 1 && out[2].order.id == 3 && out[3].order.id == 9);
+    CHECK(Instruction_copy_to(Instruction_drop(list, 3), out, 4) == 2);
+    CHECK(Instruction_copy_to(list, out, 0) == 0);
+}
+
+static void test_contiguous(void)
+{
+    InstructionList *scattered = Instruction_concat(range(3), Instruction_drop(range(5), 3));
+    InstructionList *compact = Instruction_compact(scattered);
+    CHECK(compact != scattered && Instruction_equal(compact, scattered));
+    CHECK(&compact[4] == Instruction_drop(compact, 4));
+    CHECK(Instruction_compact(empty_InstructionList) == empty_InstructionList);
+}
+
+#define LIMIT(i, p, s, sd) ((Instruction){.type = ORDER, .order = {.id = (i), .price = (p), .size = (s), .side = (sd)}})
+#define REPLACE(i, p, s) ((Instruction){.type = CANCEL_REPLACE, .cancel_replace = {.xr_id = (i), .new_price = (p), .new_size = (s)}})
+
+static void test_match(void)
+{
+    MatchEngine engine;
+    match_engine_init(&engine, 99.0f, 0.01f, 200, 16);
+    CHECK(match_process(&engine, LIMIT(1, 100.00f, 10, SELL)) == 0);
+    CHECK(match_process(&engine, LIMIT(2, 100.00f, 4, SELL)) == 0);
+    CHECK(match_process(&engine, LIMIT(3, 100.01f, 12, BUY)) == 2);
+    CHECK(engine.events[0].kind == MATCH_FILL && engine.events[0].maker_id == 1 && engine.events[0].size == 10);
+    CHECK(engine.events[1].kind == MATCH_PARTIAL_FILL && engine.events[1].maker_id == 2 && engine.events[1].remaining == 2);
+
+    // An order for neither side is rejected without touching the ladders
+    CHECK(match_process(&engine, LIMIT(4, 100.00f, 5, (Side) 9)) == 1 && engine.events[0].kind == MATCH_REJECT);
+    CHECK(match_lookup(&engine, 4) < 0);
+
+    // Invalid replacements are rejected and the order keeps resting
+    CHECK(match_process(&engine, REPLACE(2, 500.0f, 2)) == 1 && engine.events[0].kind == MATCH_REJECT);
+    CHECK(match_process(&engine, REPLACE(2, 100.00f, 0)) == 1 && engine.events[0].kind == MATCH_REJECT);
+    CHECK(match_lookup(&engine, 2) >= 0);
+
+    // Replacing with the same price and size changes nothing
+    CHECK(match_process(&engine, REPLACE(2, 100.00f, 2)) == 0);
+    CHECK(engine.orders[match_lookup(&engine, 2)].size == 2);
+
+    // Shrinking in place acknowledges at the level price
+    CHECK(match_process(&engine, REPLACE(2, 100.004f, 1)) == 1);
+    CHECK(engine.events[0].kind == MATCH_CANCEL_ACK && engine.events[0].size == 1 && engine.events[0].remaining == 1);
+    CHECK(engine.events[0].price == match_level_price(&engine, match_level_of(&engine, 100.00f)));
+
+    CHECK(match_process(&engine, (Instruction){.type = CANCEL, .cancel = {.xid = 2}}) == 1);
+    CHECK(engine.events[0].kind == MATCH_CANCEL_ACK && engine.events[0].size == 1);
+    CHECK(match_process(&engine, (Instruction){.type = CANCEL, .cancel = {.xid = 2}}) == 1);
+    CHECK(engine.events[0].kind == MATCH_REJECT);
+    CHECK(engine.best[SELL] == -1 && engine.best[BUY] < 0);
+    match_engine_free(&engine);
+}
+
+int main()
+{
+    test_checkpoint();
+    test_interning();
+    test_seq();
+    test_queue();
+    test_arrays();
+    test_contiguous();
+    test_ingest_text();
+    test_ingest_binary();
+    test_ingest_thread();
+    test_match();
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}